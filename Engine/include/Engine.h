@@ -16,6 +16,15 @@ and increase depth progressively as they get solved.
 -------------------------------------------------------------------------------------------------------
 */
 
+// Memory in MB used by default by the engine transposition tables.
+#define ENGINE_DEFAULT_MEMORY_MB 64
+
+// Pool of transposition tables several engines can share, see tablepool.h.
+struct TablePool;
+
+// Move count from which the exact solver probes the endgame database by default.
+#define ENGINE_DEFAULT_ENDGAME_MOVES 30
+
 /*
 -------------------------------------------------------------------------------------------------------
 Other relevant structs to use the engine
@@ -124,19 +133,25 @@ public:
 	// Constructor, it calls the main loop to start analyzing the position.
 	// If no position is provided it will default to initial position. If it
 	// started suspended, resume needs to be called to start evaluating.
-	EngineConnect4(const Connect4* Position = nullptr, const char* nn_weights_file = "scheduler", bool start_suspended = false);
+	// The transposition tables will share a budget of memory_mb megabytes, if a 
+	// tables_file is provided the tables saved in it are mapped copy-on-write instead.
+	EngineConnect4(const Connect4* Position = nullptr, const char* nn_weights_file = "scheduler", bool start_suspended = false, size_t memory_mb = ENGINE_DEFAULT_MEMORY_MB, const char* tables_file = nullptr);
 
 #ifdef _BIT_BOARD
 	// Constructor, it calls the main loop to start analyzing the board.
 	// If no board is provided it will default to initial position. If it
 	// started suspended, resume needs to be called to start evaluating.
-	EngineConnect4(const Board* board, const char* nn_weights_file = "scheduler", bool start_suspended = false);
+	// The transposition tables will share a budget of memory_mb megabytes, if a 
+	// tables_file is provided the tables saved in it are mapped copy-on-write instead.
+	EngineConnect4(const Board* board, const char* nn_weights_file = "scheduler", bool start_suspended = false, size_t memory_mb = ENGINE_DEFAULT_MEMORY_MB, const char* tables_file = nullptr);
 
 #ifdef _NEURAL_NETWORK
 	// Constructor, it calls the main loop to start analyzing the board.
 	// If no board is provided it will default to initial position. If it
 	// started suspended, resume needs to be called to start evaluating.
-	EngineConnect4(const Board* board, NeuralNetwork* nn_scheduler, bool start_suspended = false);
+	// The transposition tables will share a budget of memory_mb megabytes, if a 
+	// tables_file is provided the tables saved in it are mapped copy-on-write instead.
+	EngineConnect4(const Board* board, NeuralNetwork* nn_scheduler, bool start_suspended = false, size_t memory_mb = ENGINE_DEFAULT_MEMORY_MB, const char* tables_file = nullptr);
 #endif
 #endif
 
@@ -168,7 +183,7 @@ User end functions
 
 	// It returns a position evaluation after a certain time, you can either 
 	// enter a new position or leave it at nullptr to maintain current position.
-	// If it finds a forced win it will return immediately.
+	// If it finds a forced win or the position is in the opening book it will return immediately.
 	PositionEval evaluate_for(float seconds_for_answer, const Connect4* position = nullptr);
 
 	// The new position is introduced and will not return a PositionEval until the depth of the
@@ -189,7 +204,7 @@ User end functions
 
 	// It returns a position evaluation after a certain time, you can either 
 	// enter a new board or leave it at nullptr to maintain current position.
-	// If it finds a forced win it will return immediately.
+	// If it finds a forced win or the board is in the opening book it will return immediately.
 	PositionEval evaluate_for(float seconds_for_answer, const Board* board, bool update_scheduler = true);
 
 	// The new board is introduced and will not return a PositionEval until the depth
@@ -200,13 +215,61 @@ User end functions
 	Board get_current_bitBoard() const;
 #endif
 #if defined(_HEURISTIC_TT) & defined(_BIT_BOARD)
-	// Returns the HTTEntry* to the transposition table for the specified board.
-	HTTEntry* get_entry(const Board* board) const;
+	// Copies the HTTEntry of the specified board into entry, returns false if it is not stored.
+	// Entries are written concurrently by the engine threads, so a copy is returned instead of a pointer.
+	// Stored columns are seen from the key orientation, see keyColumn().
+	bool get_entry(const Board* board, HTTEntry& entry) const;
 #endif
 #if defined(_EXACT_TT) & defined(_BIT_BOARD)
-	// Returns the TTEntry* to the transposition table for the specified board.
-	TTEntry* get_exact_entry(const Board* board) const;
+	// Copies the TTEntry of the specified board into entry, returns false if it is not stored.
+	// The table entries are packed, so a copy is returned instead of a pointer.
+	// Stored columns are seen from the key orientation, see keyColumn().
+	bool get_exact_entry(const Board* board, TTEntry& entry) const;
+#endif
+#if defined(_EXACT_TT) & defined(_HEURISTIC_TT)
+	// Copies the statistics of the exact and heuristic transposition tables, with the entries
+	// of every move count. The tables are scanned to count them, which takes a while for big
+	// tables. Probes and stores are only counted if _TT_STATS is defined, see ttstats.h.
+	void get_table_stats(TTStats& exact, TTStats& heuristic) const;
+
+	// Sets the probe and store counters of both transposition tables back to zero.
+	void reset_table_stats() const;
 #endif
+
+	// Saves the exact and heuristic transposition tables into a snapshot file, so a later
+	// engine can start with them. The engine is suspended while saving. Returns false 
+	// if the file could not be written.
+	bool save_tables(const char* tables_file) const;
+
+	// Maps the tables saved in a snapshot file in place of the current ones. If copy_on_write 
+	// the engine keeps storing its results in its own copy of the pages and the file is never
+	// modified, otherwise the tables are read-only and new results are not stored.
+	// Returns false if neither table was found, the current ones are kept in that case.
+	// Engines attached to a pool can not load tables, see attach_tables().
+	bool load_tables(const char* tables_file, bool copy_on_write = true);
+
+	// Makes the engine search with the tables of the pool instead of its own, which are released.
+	// Engines of owner 0 share every entry, the entries of other owners are only seen by engines
+	// of that same owner. nullptr gives the engine back its own tables, empty. Engines meant to be
+	// pooled can be created with memory_mb 0, the pool must outlive them.
+	void attach_tables(TablePool* pool, unsigned owner = 0);
+
+	// Forks the tables of the parent engine for this one, to analyze a branch of its position
+	// while the parent keeps running. Boards this engine does not know are looked up in the
+	// parent tables, but its results are only stored in its own, so the parent is neither
+	// modified nor stopped. Its own tables only need memory for the branch. The parent must
+	// outlive the fork, nullptr stops reading it. Returns false if the parent is this engine.
+	bool fork_tables(const EngineConnect4* parent);
+
+	// Maps an opening book built with buildOpeningBook(), see book.h. The positions found in it
+	// start with the evaluation of the book, and evaluate_for() returns them at once. nullptr 
+	// closes the current book. Returns false if the file is not a valid book.
+	bool load_book(const char* book_file);
+
+	// Maps an endgame database built with EndgameBuilder, see endgame.h. The exact solver looks
+	// up the positions with at least from_moves pieces in it instead of solving them. nullptr
+	// closes the current database. Returns false if the file is not a valid database.
+	bool load_endgame(const char* endgame_file, unsigned char from_moves = ENGINE_DEFAULT_ENDGAME_MOVES);
 	
 	// Sets the weights for the Neural Network that schedules tree calls to the ones 
 	// specified in the weights file. If nullptr or file not found no NN scheduler is used.
@@ -239,6 +302,17 @@ Static helpers
 	// It takes a Connect4 struct and returns the equivalent bitBoard.
 	// If the board position is invalid it returns nullptr.
 	static Board* translateBoard(const Connect4& position);
+
+	// It takes an array of Connect4 structs and writes the equivalent bitBoards into the 
+	// given array, no memory is allocated. If valid is provided it stores whether each 
+	// position was valid, invalid positions leave their board untouched. 
+	// Returns the amount of valid positions.
+	static size_t translateBoards(const Connect4* positions, size_t count, Board* boards, bool* valid = nullptr);
+
+	// It takes an array of move strings and writes the resulting bitBoards into the given
+	// array, no memory is allocated. Every character is a column from '1' to '8'. If valid 
+	// is provided it stores whether each string was valid. Returns the amount of valid strings.
+	static size_t translateMoves(const char* const* moves, size_t count, Board* boards, bool* valid = nullptr);
 #endif
 
 };
\ No newline at end of file
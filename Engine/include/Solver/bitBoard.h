@@ -2,6 +2,15 @@
 #include "zobrist.h"
 #include "mask.h"
 
+#include <bit>		// For __popcnt64()
+#include <stdlib.h>	// For _byteswap_uint64()
+
+#ifdef __AVX2__
+#include <immintrin.h>	// For the 256 bit winning holes kernel (compile with /arch:AVX2)
+#elif defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>	// For the 128 bit cell packing when building boards
+#endif
+
 #define _BIT_BOARD
 
 /* CONNECT4 BITBOARD HEADER FILE
@@ -10,12 +19,26 @@
 This header includes macros, enums, structures and inline functions
 to create a Connect4 bitBoard useful for fast computation.
 It includes zobrist.h that will provide a hash for any given board.
+
+Two board representations are provided, the full Board that keeps the
+heights, move count and hash up to date, and the CompactBoard that only
+stores two bitmaps and derives everything else with bit arithmetic.
+Both of them can be used by the solvers through the same helper functions,
+except the 8x8 CompactBoard, whose keys are not unique (see _compactKey()).
+
+Both are templates over the board width and height (up to 8x8), the
+engine uses the 8x8 Board and the standard 7x6 board is also provided.
+
+A position and its mirror image share the same key in the transposition
+tables, so columns stored in the tables are seen from the key orientation,
+use keyColumn() to translate them from and to the actual board.
 -------------------------------------------------------------------------------------------------------
 -------------------------------------------------------------------------------------------------------
 */
 
-// In this representation, the board is a 8x8 grid (64 cells).
+// In this representation, the board is at most a 8x8 grid (64 cells).
 // The map bit index is calculated as: index = column * 8 + row.
+// Smaller boards keep the same indices, their missing cells are never used.
 
 /*
 -------------------------------------------------------------------------------------------------------
@@ -23,6 +46,14 @@ Constants and enums for the Connect4 bitboard
 -------------------------------------------------------------------------------------------------------
 */
 
+// If defined, the Board also stores the winning holes of each player, which are
+// updated by playMove() along the lines of the placed stone and restored by undoMove()
+// from the value the caller saved with moveState() before the move.
+// Immediate win checks, threat counting and the heuristic read them directly.
+// Comment it out to go back to the smaller board that computes them when needed.
+
+#define _BOARD_THREATS
+
 // Possible results of the solver.
 // The set values are important to simplify minimax algorithm.
 enum SolveResult : char
@@ -41,6 +72,76 @@ inline SolveResult operator-(const SolveResult& other)
 	return (SolveResult)-(char)other;
 }
 
+// Preferred move orders for a given board width, generated at compile time.
+// The center columns go first since they take part in more connect4s.
+// 
+// center holds the columns from the center to the sides, padded up to 8 with the
+// columns that do not exist on narrower boards (those never have legal moves).
+// column[c] starts with column c, the one suggested by the TT, and follows the center order.
+template<unsigned char WIDTH>
+struct _MoveOrderTable
+{
+	unsigned char center[8];
+	unsigned char column[WIDTH][WIDTH];
+
+	constexpr _MoveOrderTable() : center{}, column{}
+	{
+		const int middle = (WIDTH - 1) / 2;
+
+		unsigned char count = 0;
+		center[count++] = (unsigned char)middle;
+
+		for (int offset = 1; offset < 8; offset++)
+		{
+			if (middle + offset < WIDTH)
+				center[count++] = (unsigned char)(middle + offset);
+			if (middle - offset >= 0)
+				center[count++] = (unsigned char)(middle - offset);
+		}
+
+		for (unsigned char c = WIDTH; c < 8; c++)
+			center[count++] = c;
+
+		for (unsigned char first = 0; first < WIDTH; first++)
+		{
+			unsigned char i = 0;
+			column[first][i++] = first;
+
+			for (unsigned char j = 0; j < WIDTH; j++)
+				if (center[j] != first)
+					column[first][i++] = center[j];
+		}
+	}
+};
+
+template<unsigned char WIDTH>
+inline constexpr _MoveOrderTable<WIDTH> MOVE_ORDER = {};
+
+// The four lines through every cell of the 8x8 grid, up to three cells on each side.
+// A new stone can only create holes on these lines, so playMove() collapses just them.
+struct _CellLinesTable
+{
+	uint64_t lines[64];
+
+	constexpr _CellLinesTable() : lines{}
+	{
+		constexpr int directions[4][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 } };
+
+		for (int cell = 0; cell < 64; cell++)
+			for (const auto& direction : directions)
+				for (int distance = -3; distance <= 3; distance++)
+				{
+					const int column = cell / 8 + distance * direction[0];
+					const int row = cell % 8 + distance * direction[1];
+
+					if (column >= 0 && column < 8 && row >= 0 && row < 8)
+						lines[cell] |= 1ULL << (column * 8 + row);
+				}
+	}
+};
+
+inline constexpr _CellLinesTable CELL_LINES = {};
+
 /*
 -------------------------------------------------------------------------------------------------------
 Definition of the bitboard struct that will be used for solving connect4
@@ -51,7 +152,17 @@ Definition of the bitboard struct that will be used for solving connect4
 // for fast computation. Stores the board encoded as two bitmaps, one per player.
 // The heights of each column, for fast legal move recognition, the move count
 // and side to play, and the board hash for Transposition Tables integration.
-typedef struct board {
+// The size of the board is given at compile time, the solvers read it from here.
+template<unsigned char W, unsigned char H>
+struct BasicBoard {
+
+	static_assert(W >= 4 && W <= 8 && H >= 4 && H <= 8, "The board has to fit in the 8x8 bitmap");
+
+	static constexpr unsigned char WIDTH = W;						// Number of columns
+	static constexpr unsigned char HEIGHT = H;						// Number of rows
+	static constexpr unsigned char CELLS = W * H;					// Moves until the board is full
+	static constexpr uint64_t AREA = BOARD_AREA<W, H>;				// Cells that exist on the board
+	static constexpr uint64_t BOTTOM = BOARD_BOTTOM<W, H>;			// Floor cells of the board
 
 	// Each player's pieces are represented in a 64-bit integer (bitboard)
 	uint64_t playerBitboard[2] { 0ULL, 0ULL };
@@ -59,9 +170,16 @@ typedef struct board {
 	// Board key needed for comparing in the transposition tables
 	uint64_t hash = INITIAL_HASH;
 
-	// heights[column] uses the lower 3 bits to indicate the next available row in that column (0-7)
-	// The 4th bit (8) indicates if the column is full (0 = full, 1 = not full)
-	uint8_t heights[8] = {};
+	// Hash of the board mirrored left to right, the smallest of both is the table key
+	uint64_t mirrorHash = INITIAL_HASH;
+
+#ifdef _BOARD_THREATS
+	// Cells where each player would complete a connect4 (they might be occupied)
+	uint64_t threats[2] { 0ULL, 0ULL };
+#endif
+
+	// heights[column] is the next available row in that column (HEIGHT means full)
+	uint8_t heights[W] = {};
 
 	// Number of moves played so far
 	uint8_t moveCount = 0u;
@@ -69,7 +187,35 @@ typedef struct board {
 	// Current player's turn (0 = first player, 1 = second player)
 	uint8_t sideToPlay = 0u;
 
-} Board;
+};
+
+// Defines the Connect4 bit-board in its most compact form, only 16 bytes. It stores the
+// pieces of the player to move and the mask of every occupied cell. The heights, legal
+// moves, move count and position key are derived from these two bitmaps, so a move only
+// touches two words and does not need any table lookups to keep the board up to date.
+template<unsigned char W, unsigned char H>
+struct BasicCompactBoard {
+
+	static_assert(W >= 4 && W <= 8 && H >= 4 && H <= 8, "The board has to fit in the 8x8 bitmap");
+
+	static constexpr unsigned char WIDTH = W;						// Number of columns
+	static constexpr unsigned char HEIGHT = H;						// Number of rows
+	static constexpr unsigned char CELLS = W * H;					// Moves until the board is full
+	static constexpr uint64_t AREA = BOARD_AREA<W, H>;				// Cells that exist on the board
+	static constexpr uint64_t BOTTOM = BOARD_BOTTOM<W, H>;			// Floor cells of the board
+
+	// Pieces of the player to move
+	uint64_t current = 0ULL;
+
+	// Pieces of both players combined
+	uint64_t occupied = 0ULL;
+
+};
+
+typedef BasicBoard<8, 8>			Board;				// Board used by the engine
+typedef BasicBoard<7, 6>			Board7x6;			// Standard Connect4 board
+typedef BasicCompactBoard<8, 8>		CompactBoard;		// Compact version of Board
+typedef BasicCompactBoard<7, 6>		CompactBoard7x6;	// Compact version of Board7x6
 
 /*
 -------------------------------------------------------------------------------------------------------
@@ -78,15 +224,17 @@ Helper inline functions to cleanup the code
 */
 
 // Returns the board of both player pieces combined.
-static inline uint64_t mask(const Board& board)
+template<unsigned char W, unsigned char H>
+static inline uint64_t mask(const BasicBoard<W, H>& board)
 {
 	return board.playerBitboard[0] | board.playerBitboard[1];
 }
 
 // Check if the column is not full.
-static inline bool canPlay(const Board& board, const unsigned char column)
+template<unsigned char W, unsigned char H>
+static inline bool canPlay(const BasicBoard<W, H>& board, const unsigned char column)
 {
-	return board.heights[column] ^ 8u;
+	return board.heights[column] ^ H;
 }
 
 // Returns a bit located at a given position in the board.
@@ -95,31 +243,402 @@ static inline uint64_t bit_at(const unsigned char column, const unsigned char ro
 	return 0x1ULL << (column * 8 + row);
 }
 
+// Returns the board of both player pieces combined.
+template<unsigned char W, unsigned char H>
+static inline uint64_t mask(const BasicCompactBoard<W, H>& board)
+{
+	return board.occupied;
+}
+
+// Check if the column is not full.
+template<unsigned char W, unsigned char H>
+static inline bool canPlay(const BasicCompactBoard<W, H>& board, const unsigned char column)
+{
+	return !(board.occupied & bit_at(column, H - 1));
+}
+
+/*
+-------------------------------------------------------------------------------------------------------
+Common accessors so that the solvers can run on any board representation
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Mirrors a bitmap left to right. Columns are bytes so swapping them does the job,
+// narrower boards are then shifted back to start at the first column.
+template<unsigned char W>
+static inline uint64_t mirrorBitmap(const uint64_t bitmap)
+{
+	return _byteswap_uint64(bitmap) >> (8 * (8 - W));
+}
+
+// Computes the hash of the board mirrored left to right.
+// It is as expensive as boardHash() so it is only used when building boards.
+template<unsigned char W, unsigned char H>
+static inline uint64_t boardMirrorHash(const BasicBoard<W, H>& board)
+{
+	const uint64_t mirrored[2] = { mirrorBitmap<W>(board.playerBitboard[0]), mirrorBitmap<W>(board.playerBitboard[1]) };
+	return boardHash(mirrored);
+}
+
+// Returns the key used to store the board in the transposition tables.
+// A board and its mirror image share the smallest of their two hashes.
+template<unsigned char W, unsigned char H>
+static inline uint64_t boardKey(const BasicBoard<W, H>& board)
+{
+	return board.hash < board.mirrorHash ? board.hash : board.mirrorHash;
+}
+
+// Returns true if the key of the board is the one of its mirror image.
+template<unsigned char W, unsigned char H>
+static inline bool mirroredKey(const BasicBoard<W, H>& board)
+{
+	return board.mirrorHash < board.hash;
+}
+
+// Returns the key of a compact board given its bitmaps.
+// 
+// Adding the bottom row to both bitmaps gives every column a single extra bit on top
+// of its pieces, which makes the sum unique for every position without full columns
+// (boards smaller than 8 rows always have room for that bit, even when full).
+// Then the bits are spread with a bijective mixer so that masking the key still gives
+// well distributed table indices.
+// 
+// On 8x8 the key is not unique: the extra bit of a full column carries into the next
+// one, so that board shares its key with another one, sometimes with as many stones.
+// These are systematic collisions the tables can not tell apart, so the solvers are not
+// instantiated for the 8x8 CompactBoard, it is only used to store positions.
+template<unsigned char W, unsigned char H>
+static inline uint64_t _compactKey(const uint64_t current, const uint64_t occupied)
+{
+	uint64_t key = current + occupied + BOARD_BOTTOM<W, H>;
+
+	key = (key ^ (key >> 33)) * 0xFF51AFD7ED558CCDULL;
+	key = (key ^ (key >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+	return key ^ (key >> 33);
+}
+
+// Returns the key used to store the board in the transposition tables.
+// A board and its mirror image share the smallest of their two keys.
+template<unsigned char W, unsigned char H>
+static inline uint64_t boardKey(const BasicCompactBoard<W, H>& board)
+{
+	const uint64_t key = _compactKey<W, H>(board.current, board.occupied);
+	const uint64_t mirrorKey = _compactKey<W, H>(mirrorBitmap<W>(board.current), mirrorBitmap<W>(board.occupied));
+
+	return key < mirrorKey ? key : mirrorKey;
+}
+
+// Returns true if the key of the board is the one of its mirror image.
+template<unsigned char W, unsigned char H>
+static inline bool mirroredKey(const BasicCompactBoard<W, H>& board)
+{
+	return _compactKey<W, H>(mirrorBitmap<W>(board.current), mirrorBitmap<W>(board.occupied)) < _compactKey<W, H>(board.current, board.occupied);
+}
+
+// Translates a column between the board and the key orientation used in the tables.
+// Mirroring twice gives back the same column, so it works in both directions.
+// Values outside of the board (like the 255 used for no column) are left untouched.
+template<typename BoardType>
+static inline unsigned char keyColumn(const BoardType& board, const unsigned char column)
+{
+	return (column < BoardType::WIDTH && mirroredKey(board)) ? BoardType::WIDTH - 1 - column : column;
+}
+
+// Returns the number of moves played so far.
+template<unsigned char W, unsigned char H>
+static inline uint8_t playedMoves(const BasicBoard<W, H>& board)
+{
+	return board.moveCount;
+}
+
+// Returns the number of moves played so far.
+template<unsigned char W, unsigned char H>
+static inline uint8_t playedMoves(const BasicCompactBoard<W, H>& board)
+{
+	return (uint8_t)__popcnt64(board.occupied);
+}
+
+// Returns the pieces of the player to move.
+template<unsigned char W, unsigned char H>
+static inline uint64_t currentPieces(const BasicBoard<W, H>& board)
+{
+	return board.playerBitboard[board.sideToPlay];
+}
+
+// Returns the pieces of the player to move.
+template<unsigned char W, unsigned char H>
+static inline uint64_t currentPieces(const BasicCompactBoard<W, H>& board)
+{
+	return board.current;
+}
+
+// Returns the pieces of the player that just moved.
+template<unsigned char W, unsigned char H>
+static inline uint64_t otherPieces(const BasicBoard<W, H>& board)
+{
+	return board.playerBitboard[board.sideToPlay ^ 1];
+}
+
+// Returns the pieces of the player that just moved.
+template<unsigned char W, unsigned char H>
+static inline uint64_t otherPieces(const BasicCompactBoard<W, H>& board)
+{
+	return board.current ^ board.occupied;
+}
+
+// Returns the amount of pieces in a column (H means full).
+template<unsigned char W, unsigned char H>
+static inline uint8_t columnHeight(const BasicBoard<W, H>& board, const unsigned char column)
+{
+	return board.heights[column];
+}
+
+// Returns the amount of pieces in a column (H means full).
+template<unsigned char W, unsigned char H>
+static inline uint8_t columnHeight(const BasicCompactBoard<W, H>& board, const unsigned char column)
+{
+	return (uint8_t)__popcnt64(board.occupied & COL_MASK(column));
+}
+
+// Returns the bit where the next stone in that column would be placed.
+template<unsigned char W, unsigned char H>
+static inline uint64_t nextCell(const BasicBoard<W, H>& board, const unsigned char column)
+{
+	return bit_at(column, board.heights[column]);
+}
+
+// Returns the bit where the next stone in that column would be placed.
+// Adding one to the bottom of a not full column carries up to the first empty cell.
+template<unsigned char W, unsigned char H>
+static inline uint64_t nextCell(const BasicCompactBoard<W, H>& board, const unsigned char column)
+{
+	return (board.occupied + bit_at(column, 0)) & COL_MASK(column);
+}
+
+/*
+-------------------------------------------------------------------------------------------------------
+Legal move generation and iteration helpers
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Returns a bitmap with one bit set on every cell where a stone can be placed.
+// Each occupied cell marks the one above it, floor cells are always candidates,
+// and the occupied cells are removed. Full columns leave no bit inside the board area.
+template<typename BoardType>
+static inline uint64_t legalMoves(const BoardType& board)
+{
+	const uint64_t boardMask = mask(board);
+	return ((SHIFT_NORTH(boardMask) & MASK_1N) | BoardType::BOTTOM) & ~boardMask & BoardType::AREA;
+}
+
+// Returns the move of a given column inside a legal moves bitmap (0 if not playable).
+static inline uint64_t columnMove(const uint64_t moves, const unsigned char column)
+{
+	return moves & COL_MASK(column);
+}
+
+// Returns the column of a single bit move (of the lowest one if there are more).
+static inline unsigned char columnOf(const uint64_t move)
+{
+	return (unsigned char)(std::countr_zero(move) >> 3);
+}
+
+// Returns the row of a single bit move.
+static inline unsigned char rowOf(const uint64_t move)
+{
+	return (unsigned char)(std::countr_zero(move) & 7);
+}
+
+// Returns the lowest move of the bitmap and removes it, for looping over every
+// legal move with: while (moves) { uint64_t move = popMove(moves); ... }
+static inline uint64_t popMove(uint64_t& moves)
+{
+	const uint64_t move = moves & (0ULL - moves);
+	moves ^= move;
+	return move;
+}
+
+// Compresses a legal moves bitmap into a byte with one bit per playable column.
+// Every column is folded onto its bottom cell, then the multiplication gathers
+// the bottom cells of all the columns on the top byte without any carries.
+static inline uint8_t playableColumns(const uint64_t moves)
+{
+	uint64_t columns = moves | (moves >> 4);
+	columns |= columns >> 2;
+	columns |= columns >> 1;
+
+	return (uint8_t)(((columns & Row0) * 0x0102040810204080ULL) >> 56);
+}
+
+/*
+-------------------------------------------------------------------------------------------------------
+Threat detection and move pruning
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Returns all the cells where the given pieces would complete a connect4, the
+// holes are collapsed in every direction like in the heuristic. Cells that are
+// already occupied can also be marked, so mask them out if needed.
+// The holes are found on the 8x8 grid, smaller boards have to cut them with their area.
+// With AVX2 the four directions are collapsed together, one per 64 bit lane,
+// and the lanes are merged at the end. Otherwise the scalar macros are used.
+static inline uint64_t winningHoles(const uint64_t pieces)
+{
+#ifdef __AVX2__
+	const __m256i bitmap = _mm256_set1_epi64x((long long)pieces);
+
+	__m256i forward[3], backward[3];
+	for (unsigned char i = 0; i < 3; i++)
+	{
+		const __m256i shift = _mm256_load_si256((const __m256i*)DIRECTION_SHIFT[i]);
+
+		forward[i]  = _mm256_and_si256(_mm256_sllv_epi64(bitmap, shift), _mm256_load_si256((const __m256i*)DIRECTION_MASK_FORWARD[i]));
+		backward[i] = _mm256_and_si256(_mm256_srlv_epi64(bitmap, shift), _mm256_load_si256((const __m256i*)DIRECTION_MASK_BACKWARD[i]));
+	}
+
+	// Same four patterns as the COLLAPSE macros: 3L, 2L1R, 1L2R and 3R.
+
+	const __m256i inner = _mm256_and_si256(forward[0], backward[0]);
+
+	const __m256i holes = _mm256_or_si256(
+		_mm256_or_si256(
+			_mm256_and_si256(_mm256_and_si256(forward[2], forward[1]), forward[0]),
+			_mm256_and_si256(inner, forward[1])),
+		_mm256_or_si256(
+			_mm256_and_si256(inner, backward[1]),
+			_mm256_and_si256(_mm256_and_si256(backward[2], backward[1]), backward[0])));
+
+	const __m128i merged = _mm_or_si128(_mm256_castsi256_si128(holes), _mm256_extracti128_si256(holes, 1));
+
+	return (uint64_t)_mm_cvtsi128_si64(merged) | (uint64_t)_mm_extract_epi64(merged, 1);
+#else
+	return COLLAPSE_ALL_WINNING_MOVES(pieces) | TOTAL_COLLAPSE_VERTICAL(pieces);
+#endif
+}
+
+// Returns the empty cells where the given pieces would complete a connect4.
+static inline uint64_t winningCells(const uint64_t pieces, const uint64_t boardMask)
+{
+	return winningHoles(pieces) & ~boardMask;
+}
+
+// Recomputes the stored winning holes of both players from scratch.
+// Used when a board is built without playing its moves one by one.
+template<unsigned char W, unsigned char H>
+static inline void computeThreats(BasicBoard<W, H>& board)
+{
+#ifdef _BOARD_THREATS
+	board.threats[0] = winningHoles(board.playerBitboard[0]) & BasicBoard<W, H>::AREA;
+	board.threats[1] = winningHoles(board.playerBitboard[1]) & BasicBoard<W, H>::AREA;
+#else
+	(void)board;
+#endif
+}
+
+// Returns the winning holes of the player to move (they might be occupied).
+template<unsigned char W, unsigned char H>
+static inline uint64_t currentThreats(const BasicBoard<W, H>& board)
+{
+#ifdef _BOARD_THREATS
+	return board.threats[board.sideToPlay];
+#else
+	return winningHoles(currentPieces(board)) & BasicBoard<W, H>::AREA;
+#endif
+}
+
+// Returns the winning holes of the player that just moved (they might be occupied).
+template<unsigned char W, unsigned char H>
+static inline uint64_t otherThreats(const BasicBoard<W, H>& board)
+{
+#ifdef _BOARD_THREATS
+	return board.threats[board.sideToPlay ^ 1];
+#else
+	return winningHoles(otherPieces(board)) & BasicBoard<W, H>::AREA;
+#endif
+}
+
+// Returns the winning holes of the player to move (they might be occupied).
+template<unsigned char W, unsigned char H>
+static inline uint64_t currentThreats(const BasicCompactBoard<W, H>& board)
+{
+	return winningHoles(currentPieces(board)) & BasicCompactBoard<W, H>::AREA;
+}
+
+// Returns the winning holes of the player that just moved (they might be occupied).
+template<unsigned char W, unsigned char H>
+static inline uint64_t otherThreats(const BasicCompactBoard<W, H>& board)
+{
+	return winningHoles(otherPieces(board)) & BasicCompactBoard<W, H>::AREA;
+}
+
+// Returns the legal moves that win the game right away for the player to move.
+template<typename BoardType>
+static inline uint64_t winningMoves(const BoardType& board)
+{
+	return legalMoves(board) & currentThreats(board);
+}
+
+// Returns a byte with one bit set for every column that wins right away,
+// so move loops can check each child with a single bit test.
+template<typename BoardType>
+static inline uint8_t winningColumns(const BoardType& board)
+{
+	return playableColumns(winningMoves(board));
+}
+
+// Returns the legal moves that do not give the opponent an immediate win.
+// It assumes the player to move can not win with its next move.
+// 
+// If the opponent has a winning cell that can be played next, that is the only move
+// allowed, and if there are two of them the position is lost and 0 is returned.
+// Moves right below an opponent winning cell are also removed, since they would let
+// the opponent play on top. If every move loses the bitmap is 0.
+template<typename BoardType>
+static inline uint64_t nonLosingMoves(const BoardType& board)
+{
+	uint64_t moves = legalMoves(board);
+	const uint64_t opponentWins = otherThreats(board) & ~mask(board);
+
+	if (const uint64_t forced = moves & opponentWins)
+	{
+		if (forced & (forced - 1))
+			return 0ULL;
+
+		moves = forced;
+	}
+
+	return moves & ~SHIFT_SOUTH(opponentWins & MASK_1N);
+}
+
 /*
 -------------------------------------------------------------------------------------------------------
 In game functions for board operations
 -------------------------------------------------------------------------------------------------------
 */
 
-// Checks if the board is valid by checking if there are any floating pieces,
-// if the hash of the board corresponds with the one it is supposed to be,
-// and if the move count matches the pieces on the board.
-static inline bool invalidBoard(const Board& board)
+// Checks if the board is valid by checking if there are any floating pieces or
+// pieces outside of the board, if the hash of the board corresponds with the one
+// it is supposed to be, and if the move count matches the pieces on the board.
+template<unsigned char W, unsigned char H>
+static inline bool invalidBoard(const BasicBoard<W, H>& board)
 {
 	unsigned char moveCount = 0;
 
 	if (board.playerBitboard[0] & board.playerBitboard[1])
 		return true;
 
-	if (board.hash != boardHash(board.playerBitboard))
+	if (board.hash != boardHash(board.playerBitboard) || board.mirrorHash != boardMirrorHash(board))
 		return true;
 
 	uint64_t boardMask = mask(board);
-	for (unsigned char column = 0; column < 8; column++)
+	if (boardMask & ~BasicBoard<W, H>::AREA)
+		return true;
+
+	for (unsigned char column = 0; column < W; column++)
 	{
 		const uint8_t height = board.heights[column];
 
-		if (height > 8)
+		if (height > H)
 			return true;
 
 		moveCount += height;
@@ -132,26 +651,55 @@ static inline bool invalidBoard(const Board& board)
 	if (moveCount != board.moveCount)
 		return true;
 
+#ifdef _BOARD_THREATS
+	if (board.threats[0] != (winningHoles(board.playerBitboard[0]) & BasicBoard<W, H>::AREA) ||
+		board.threats[1] != (winningHoles(board.playerBitboard[1]) & BasicBoard<W, H>::AREA))
+		return true;
+#endif
+
 	return false;
 }
 
 // Places a stone for side-to-move in column c (assumes can_play was true).
 // Updates board hash and switches player at the end of the move.
-static inline void playMove(Board& board, const unsigned char column)
+template<unsigned char W, unsigned char H>
+static inline void playMove(BasicBoard<W, H>& board, const unsigned char column)
 {
 	const uint8_t row = board.heights[column]++;
 	const uint64_t move = bit_at(column, row);
 
 	board.playerBitboard[board.sideToPlay] |= move;
 	board.hash ^= Z_PIECE[board.sideToPlay][column * 8 + row];
+	board.mirrorHash ^= Z_PIECE[board.sideToPlay][(W - 1 - column) * 8 + row];
+
+#ifdef _BOARD_THREATS
+	// A stone only adds holes, and only on the lines that go through it.
+	const uint64_t lines = CELL_LINES.lines[column * 8 + row];
+	board.threats[board.sideToPlay] |= winningHoles(board.playerBitboard[board.sideToPlay] & lines) & lines & BasicBoard<W, H>::AREA;
+#endif
 
 	board.sideToPlay ^= 1; // toggle side to move
 	++board.moveCount;
 }
 
-// Switches player back to previous move and ndoes hash changes.
+// Returns what undoMove() needs to take back a move without recomputing the board,
+// it has to be read before playMove(). A stone only adds holes to the player that moves,
+// so those are the only threats that cannot be rebuilt from the stones that are left.
+template<unsigned char W, unsigned char H>
+static inline uint64_t moveState(const BasicBoard<W, H>& board)
+{
+#ifdef _BOARD_THREATS
+	return board.threats[board.sideToPlay];
+#else
+	return 0ULL;
+#endif
+}
+
+// Switches player back to previous move and undoes hash changes.
 // Removes last stone placed in that column (assumes it was played by the correct player).
-static inline void undoMove(Board& board, const unsigned char column)
+// The state is the one returned by moveState() before the move was played.
+template<unsigned char W, unsigned char H>
+static inline void undoMove(BasicBoard<W, H>& board, const unsigned char column, const uint64_t state)
 {
 	board.sideToPlay ^= 1; // untoggle side to move
 	--board.moveCount;
@@ -161,6 +709,114 @@ static inline void undoMove(Board& board, const unsigned char column)
 
 	board.playerBitboard[board.sideToPlay] ^= move;
 	board.hash ^= Z_PIECE[board.sideToPlay][column * 8 + row];
+	board.mirrorHash ^= Z_PIECE[board.sideToPlay][(W - 1 - column) * 8 + row];
+
+#ifdef _BOARD_THREATS
+	board.threats[board.sideToPlay] = state;
+#else
+	(void)state;
+#endif
+}
+
+// Places a stone for side-to-move in column c (assumes can_play was true).
+// The current bitmap becomes the opponent pieces, so the side is switched for free.
+template<unsigned char W, unsigned char H>
+static inline void playMove(BasicCompactBoard<W, H>& board, const unsigned char column)
+{
+	board.current ^= board.occupied;
+	board.occupied |= board.occupied + bit_at(column, 0);
+}
+
+// The compact board rebuilds everything from its bitmaps, so it keeps no state.
+template<unsigned char W, unsigned char H>
+static inline uint64_t moveState(const BasicCompactBoard<W, H>&)
+{
+	return 0ULL;
+}
+
+// Removes last stone placed in that column and switches player back.
+// The top stone of the column is the only bit that is not repeated one row below.
+template<unsigned char W, unsigned char H>
+static inline void undoMove(BasicCompactBoard<W, H>& board, const unsigned char column, const uint64_t)
+{
+	const uint64_t columnMask = board.occupied & COL_MASK(column);
+
+	board.occupied ^= (columnMask ^ (columnMask >> 1)) & COL_MASK(column);
+	board.current ^= board.occupied;
+}
+
+// Returns the table key the board would have after playing in the given column,
+// without playing it. The hashes are only updated with the stone of the move.
+template<unsigned char W, unsigned char H>
+static inline uint64_t childKey(const BasicBoard<W, H>& board, const unsigned char column)
+{
+	const uint8_t row = board.heights[column];
+	const uint64_t hash = board.hash ^ Z_PIECE[board.sideToPlay][column * 8 + row];
+	const uint64_t mirrorHash = board.mirrorHash ^ Z_PIECE[board.sideToPlay][(W - 1 - column) * 8 + row];
+
+	return hash < mirrorHash ? hash : mirrorHash;
+}
+
+// Returns the table key the board would have after playing in the given column,
+// without playing it. Compact keys are computed from the bitmaps, so a copy is played.
+template<unsigned char W, unsigned char H>
+static inline uint64_t childKey(const BasicCompactBoard<W, H>& board, const unsigned char column)
+{
+	BasicCompactBoard<W, H> child = board;
+	playMove(child, column);
+
+	return boardKey(child);
+}
+
+// Checks if the compact board is valid by checking that the current pieces are
+// inside the occupied mask, that the occupied mask is inside the board and
+// that there are no floating pieces in any column.
+template<unsigned char W, unsigned char H>
+static inline bool invalidBoard(const BasicCompactBoard<W, H>& board)
+{
+	if (board.current & ~board.occupied)
+		return true;
+
+	if (board.occupied & ~BasicCompactBoard<W, H>::AREA)
+		return true;
+
+	for (unsigned char column = 0; column < W; column++)
+	{
+		const uint64_t expected = ((1ULL << columnHeight(board, column)) - 1) << (8 * column);
+		if ((board.occupied & COL_MASK(column)) != expected)
+			return true;
+	}
+
+	return false;
+}
+
+// Converts a full board into its compact representation.
+template<unsigned char W, unsigned char H>
+static inline BasicCompactBoard<W, H> toCompact(const BasicBoard<W, H>& board)
+{
+	return BasicCompactBoard<W, H>{ currentPieces(board), mask(board) };
+}
+
+// Converts a compact board back into the full representation.
+// The side to play can not be derived from the bitmaps, so it has to be provided.
+template<unsigned char W, unsigned char H>
+static inline BasicBoard<W, H> fromCompact(const BasicCompactBoard<W, H>& compact, const uint8_t sideToPlay)
+{
+	BasicBoard<W, H> board;
+
+	board.playerBitboard[sideToPlay] = currentPieces(compact);
+	board.playerBitboard[sideToPlay ^ 1] = otherPieces(compact);
+	board.hash = boardHash(board.playerBitboard);
+	board.mirrorHash = boardMirrorHash(board);
+
+	for (unsigned char column = 0; column < W; column++)
+		board.heights[column] = columnHeight(compact, column);
+
+	board.moveCount = playedMoves(compact);
+	board.sideToPlay = sideToPlay;
+	computeThreats(board);
+
+	return board;
 }
 
 // Check if the current player has a winning position.
@@ -189,4 +845,123 @@ inline bool is_win(const uint64_t playerBitboard)
 	if (m & SHIFT_2_SE(m) & MASK_3SE) return true;
 
 	return false;
-}
\ No newline at end of file
+}
+
+/*
+-------------------------------------------------------------------------------------------------------
+Board ingestion from cell arrays and move strings
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Transposes a bitmap seen as an 8x8 bit matrix, bit (row * 8 + column) goes to bit (column * 8 + row).
+// Cell arrays are stored row by row while bitboards are stored column by column.
+// Each step swaps the bits across the diagonal in blocks of 2x2, 4x4 and 8x8.
+static inline uint64_t _transposeBitmap(uint64_t x)
+{
+	uint64_t t;
+
+	t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+	x ^= t ^ (t << 7);
+	t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+	x ^= t ^ (t << 14);
+	t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+	x ^= t ^ (t << 28);
+
+	return x;
+}
+
+// Packs a row by row array of 64 cells into bitmaps of the cells that are empty,
+// of the first player and of the second player (values 0, 1 and 2), in that order.
+// The bytes are compared in bulk and the results are packed with movemask.
+static inline void _packCells(const unsigned char cells[64], uint64_t packed[3])
+{
+#ifdef __AVX2__
+	const __m256i low = _mm256_loadu_si256((const __m256i*)cells);
+	const __m256i high = _mm256_loadu_si256((const __m256i*)(cells + 32));
+
+	for (unsigned char value = 0; value < 3; value++)
+	{
+		const __m256i v = _mm256_set1_epi8((char)value);
+
+		packed[value] =  (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, v)) |
+						((uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, v)) << 32);
+	}
+#elif defined(_M_X64) || defined(__SSE2__)
+	__m128i lanes[4];
+	for (unsigned char i = 0; i < 4; i++)
+		lanes[i] = _mm_loadu_si128((const __m128i*)(cells + 16 * i));
+
+	for (unsigned char value = 0; value < 3; value++)
+	{
+		const __m128i v = _mm_set1_epi8((char)value);
+
+		packed[value] = 0ULL;
+		for (unsigned char i = 0; i < 4; i++)
+			packed[value] |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(lanes[i], v)) << (16 * i);
+	}
+#else
+	packed[0] = packed[1] = packed[2] = 0ULL;
+
+	for (unsigned char i = 0; i < 64; i++)
+		if (cells[i] < 3)
+			packed[cells[i]] |= 1ULL << i;
+#endif
+}
+
+// Builds a board from a row by row array of 8x8 cells, rows go from bottom to top and
+// each cell is 0 if empty, 1 for the first player and 2 for the second player.
+// Returns false if the cells do not make a valid board (unknown values, pieces 
+// outside of the board or floating pieces), in that case the board is left untouched.
+// Unlike invalidBoard() the hashes are computed once and not checked again.
+template<unsigned char W, unsigned char H>
+static inline bool cellsToBoard(const unsigned char cells[64], const uint8_t sideToPlay, BasicBoard<W, H>& board)
+{
+	uint64_t packed[3];
+	_packCells(cells, packed);
+
+	const uint64_t pieces0 = _transposeBitmap(packed[1]);
+	const uint64_t pieces1 = _transposeBitmap(packed[2]);
+	const uint64_t occupied = pieces0 | pieces1;
+
+	// Every piece has to be on the floor or on top of another piece
+	const uint64_t floating = occupied & ~((occupied << 1) | Row0);
+
+	if ((packed[0] | packed[1] | packed[2]) != ~0ULL || (occupied & ~BasicBoard<W, H>::AREA) || floating)
+		return false;
+
+	board.playerBitboard[0] = pieces0;
+	board.playerBitboard[1] = pieces1;
+	board.hash = boardHash(board.playerBitboard);
+	board.mirrorHash = boardMirrorHash(board);
+
+	for (unsigned char column = 0; column < W; column++)
+		board.heights[column] = (uint8_t)__popcnt64(occupied & COL_MASK(column));
+
+	board.moveCount = (uint8_t)__popcnt64(occupied);
+	board.sideToPlay = sideToPlay;
+	computeThreats(board);
+
+	return true;
+}
+
+// Builds a board by playing a string of moves from the initial position, every 
+// character is the column of a move starting from '1', until the end of the string.
+// Returns false if a character is not a column or if the column is full.
+// The hashes and threats are updated incrementally by playMove().
+template<unsigned char W, unsigned char H>
+static inline bool movesToBoard(const char* moves, BasicBoard<W, H>& board)
+{
+	board = BasicBoard<W, H>();
+
+	for (; *moves; moves++)
+	{
+		const unsigned char column = (unsigned char)(*moves - '1');
+
+		if (column >= W || !canPlay(board, column))
+			return false;
+
+		playMove(board, column);
+	}
+
+	return true;
+}
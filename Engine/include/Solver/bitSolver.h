@@ -1,12 +1,23 @@
 #pragma once
 #include "bitBoard.h"
 #include "tt.h"
+#include "endgame.h"
 
 /* EXACT TREE SOLVING FUNTIONS HEADER FILE
 -------------------------------------------------------------------------------------------------------
 -------------------------------------------------------------------------------------------------------
 This header includes functions to solve board positions up to 
 a given depth, its return values are either win, loss or draw.
+The distance solver also scores how far the game is from ending.
+
+All the functions are templated over the board representation and size,
+they are instantiated for Board and the standard 7x6 versions (Board7x6 and
+CompactBoard7x6) in bitSolver.cpp. The 8x8 CompactBoard is left out since its
+keys are not unique, see _compactKey().
+
+The exact tree can probe an endgame database of solved positions, see
+endgame.h, positions are collected into it with collectEndgame().
+The database is handed to every call, like the transposition table.
 -------------------------------------------------------------------------------------------------------
 -------------------------------------------------------------------------------------------------------
 */
@@ -16,22 +27,60 @@ a given depth, its return values are either win, loss or draw.
 // Uses transposition tables, with best move ordering and alpha beta pruning.
 // Use of this function in particular is only for direct interaction by engines.
 // For user-end use is safer to use the other functions.
-extern inline SolveResult exactTree(Board& board, SolveResult alpha, SolveResult beta, unsigned char depth, TransTable* TT, void* HTT, unsigned char no_HTT_depth, bool* stop);
+// If an endgame database is given the boards it covers are looked up in it, see EndgameDatabase::covers().
+template<typename BoardType>
+extern SolveResult exactTree(BoardType& board, SolveResult alpha, SolveResult beta, unsigned char depth, TransTable* TT, void* HTT, unsigned char no_HTT_depth, bool* stop, const EndgameDatabase* endgame = nullptr);
+
+// Score of the distance solver for a game won in the given ply (number of moves on the
+// board after the winning move), it is negated for the losing side and a draw is 0.
+// Since it only depends on the ply where the game ends, negamax just negates it and
+// faster wins or slower losses always score higher.
+template<typename BoardType>
+static inline int8_t distanceScore(const unsigned char ply)
+{
+	return (int8_t)(BoardType::CELLS + 1 - ply);
+}
+
+// Returns the number of moves left until the end of the game from a distance score,
+// given the moves played so far. Only meaningful for wins and losses.
+template<typename BoardType>
+static inline unsigned char scoreDistance(const int8_t score, const unsigned char moveCount)
+{
+	return (unsigned char)(BoardType::CELLS + 1 - (score < 0 ? -score : score) - moveCount);
+}
+
+// Same as exactTree but its scores encode when the game ends, see distanceScore().
+// A single search returns the fastest win or the longest defence and its first move.
+// Its TT entries store distance scores, so it needs its own transposition tables.
+template<typename BoardType>
+extern int8_t distanceTree(BoardType& board, int8_t alpha, int8_t beta, unsigned char depth, TransTable* TT, bool* stop);
 
 // Returns the score of the board found after generating a tree.
 // The tree uses alpha-beta pruning and its depth moves deep.
-extern SolveResult solveBoard(const Board& initialBoard, unsigned char depth, TransTable* TT = nullptr);
+// The endgame database, if any, is probed like exactTree does.
+template<typename BoardType>
+extern SolveResult solveBoard(const BoardType& initialBoard, unsigned char depth, TransTable* TT = nullptr, const EndgameDatabase* endgame = nullptr);
 
 // Same as the previous one but assumes validity checks have been done.
 // Used for win checks on bigger heuristic trees.
-extern SolveResult noChecksSolveBoard(const Board& initialBoard, unsigned char depth, TransTable* TT = nullptr);
+template<typename BoardType>
+extern SolveResult noChecksSolveBoard(const BoardType& initialBoard, unsigned char depth, TransTable* TT = nullptr);
 
 // If the position is stored on the transposition table it retrieves the best column.
 // if the position is a mate situation it does not guarantee best path.
-extern unsigned char retrieveColumn(const Board& board, TransTable* TT = nullptr);
+template<typename BoardType>
+extern unsigned char retrieveColumn(const BoardType& board, TransTable* TT = nullptr);
 
 // If there is a forced win by any of the players it will find the best move.
 // For the winning player is the one that wins the fastest.
 // For the losing player is the one that delays the loss the longest.
 // First value is the column, second is the distance, third is the result.
-extern char* findBestPath(const Board& board, SolveResult WhoWins, TransTable* TT = nullptr, bool* stop = nullptr);
\ No newline at end of file
+// It uses the distance solver, so the TT must only be used by this function.
+template<typename BoardType>
+extern char* findBestPath(const BoardType& board, SolveResult WhoWins, TransTable* TT = nullptr, bool* stop = nullptr);
+
+// Solves the board with the distance solver and adds its score to the builder.
+// Returns false if the board is not valid, the game is over or it was stopped.
+// It uses findBestPath, so the TT must only be used by the distance solver.
+template<typename BoardType>
+extern bool collectEndgame(const BoardType& board, EndgameBuilder& builder, TransTable* TT = nullptr, bool* stop = nullptr);
@@ -0,0 +1,183 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "zobrist.h"		// The stored keys are only valid for the same zobrist values
+#include "VirtualMemory.h"	// For mapping the book file
+
+/* OPENING BOOK HEADER FILE
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+This header defines the opening book, a file with the evaluation of every
+position of the first moves of the game, so the engine does not have to
+compute them again every game.
+
+The book is built offline by buildOpeningBook(), which evaluates the
+positions with the heuristic tree using every processor. The file holds
+a header followed by the entries sorted by key, it is memory mapped by
+the OpeningBook struct and searched with a binary search, so only the
+pages that are looked at are ever read.
+
+Keys are the ones of the engine Board (8x8), see boardKey().
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+*/
+
+/*
+-------------------------------------------------------------------------------------------------------
+Macros for opening books
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Values that identify a book file. The version must be increased with any change
+// of the entries layout, and the keys value changes if the zobrist values change.
+
+#define BOOK_MAGIC 0xC4B00C4B00C4B00CULL
+#define BOOK_VERSION 1u
+#define BOOK_KEYS (INITIAL_HASH ^ ZOBRIST_SEED)
+
+// Memory used by default by the tables shared by the book builder threads, in megabytes.
+#define BOOK_DEFAULT_MEMORY_MB 1024
+
+/*
+-------------------------------------------------------------------------------------------------------
+Book structures
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Header at the start of every book file.
+struct BookHeader
+{
+    uint64_t magic = BOOK_MAGIC;
+    uint32_t version = BOOK_VERSION;
+    uint8_t plies = 0;              // Moves played on the deepest positions of the book
+    uint8_t depth = 0;              // Heuristic depth the positions were evaluated to
+    uint8_t exactTail = 0;          // Exact depth used by the heuristic
+    uint8_t reserved = 0;
+    uint64_t keys = BOOK_KEYS;
+    uint64_t count = 0;             // Number of entries after the header
+};
+
+// Evaluation of a position stored in the book.
+struct BookEntry
+{
+    uint64_t key;           // Key of the board, see boardKey()
+    float    eval;          // -1 to +1 from the side to play
+    uint8_t  column;        // Best column, seen from the key orientation like in the tables
+    uint8_t  heuDepth;      // Heuristic depth of the evaluation
+    uint8_t  bitDepth;      // Exact depth of the evaluation
+    uint8_t  moveCount;     // Moves played on the board
+};
+
+static_assert(sizeof(BookEntry) == 16, "Book entries are stored as they are in the file");
+
+// This structure holds an opening book mapped from its file. Lookups only read
+// the mapped memory, so it can be shared by any number of threads once opened.
+struct OpeningBook
+{
+private:
+    void* mapping = nullptr;            // Book file mapped in memory
+    size_t bytes = 0;                   // Size of the mapped file
+    const BookHeader* header = nullptr; // Header at the start of the file
+    const BookEntry* entries = nullptr; // Entries sorted by key, after the header
+
+public:
+    OpeningBook() = default;
+    inline ~OpeningBook()
+    {
+        close();
+    }
+
+    // No copies of a book are allowed, it owns its mapping.
+    OpeningBook(const OpeningBook&) = delete;
+    // No copies of a book are allowed, it owns its mapping.
+    OpeningBook& operator=(const OpeningBook&) = delete;
+
+    // Maps the given book file, closing the current one. Returns false if
+    // the file is not a valid book, in that case no book is left open.
+    inline bool open(const char* filename)
+    {
+        close();
+
+        size_t file_bytes = 0;
+        void* file = VirtualMemory::map_file(filename, file_bytes, false);
+        const BookHeader* head = (const BookHeader*)file;
+
+        if (!file || file_bytes < sizeof(BookHeader) || head->magic != BOOK_MAGIC || head->version != BOOK_VERSION ||
+            head->keys != BOOK_KEYS || head->count > (file_bytes - sizeof(BookHeader)) / sizeof(BookEntry))
+        {
+            VirtualMemory::unmap_file(file, file_bytes);
+            return false;
+        }
+
+        mapping = file;
+        bytes = file_bytes;
+        header = head;
+        entries = (const BookEntry*)(head + 1);
+        return true;
+    }
+
+    // Unmaps the book file if there is one.
+    inline void close()
+    {
+        VirtualMemory::unmap_file(mapping, bytes);
+
+        mapping = nullptr;
+        bytes = 0;
+        header = nullptr;
+        entries = nullptr;
+    }
+
+    // Checks whether a book is open.
+    inline bool is_open() const
+    {
+        return header;
+    }
+
+    // Returns the number of positions in the book.
+    inline size_t size() const
+    {
+        return header ? (size_t)header->count : 0;
+    }
+
+    // Returns the moves played on the deepest positions of the book.
+    inline unsigned char plies() const
+    {
+        return header ? header->plies : 0;
+    }
+
+    // Looks for the key in the book, if found it copies its entry and returns true.
+    inline bool find(uint64_t key, BookEntry& entry) const
+    {
+        size_t low = 0;
+        size_t high = size();
+
+        while (low < high)
+        {
+            const size_t mid = low + (high - low) / 2;
+
+            if (entries[mid].key < key)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        if (low == size() || entries[low].key != key)
+            return false;
+
+        entry = entries[low];
+        return true;
+    }
+};
+
+/*
+-------------------------------------------------------------------------------------------------------
+Book building functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Builds an opening book with every position reached in up to the given plies, evaluated by the
+// heuristic tree up to the given depth, and writes it into the book file. Positions already won
+// are left out. The positions are split between n_threads (0 uses every processor), that share
+// transposition tables of memory_mb megabytes. Returns the number of positions written, 0 if
+// the book could not be built or written.
+extern size_t buildOpeningBook(const char* book_file, unsigned char plies, unsigned char depth, size_t memory_mb = BOOK_DEFAULT_MEMORY_MB, unsigned n_threads = 0);
@@ -0,0 +1,366 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <bit>				// For std::popcount()
+#include "zobrist.h"		// The stored keys are only valid for the same zobrist values
+#include "VirtualMemory.h"	// For mapping the database file
+
+/* ENDGAME DATABASE HEADER FILE
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+This header defines the endgame database, a file with the solved score of
+positions collected from solver runs, so later runs do not solve them again.
+The exact solver probes the database it is given, see exactTree() in bitSolver.h.
+
+Positions are indexed with a minimal perfect hash over their keys, so the
+keys themselves are not stored. Every level of the hash is a bit array where
+the keys that fall alone in their bit are placed, the ones that collide go
+on to the next level. The index of a key is the rank of its bit among all the
+bits set. With arrays twice as big as their keys it takes about 3.7 bits per
+position plus 1/8 for the rank counters.
+
+Each position stores a 32-bit fingerprint of its key, to reject positions
+that are not in the database, and its distance score (see distanceScore()),
+which holds both the result and how far the end of the game is. In total
+it takes about 5.5 bytes per position.
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+*/
+
+/*
+-------------------------------------------------------------------------------------------------------
+Macros for endgame databases
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Values that identify an endgame database file. The version must be increased with any change
+// of the layout or the hash functions, and the keys value changes if the zobrist values change.
+
+#define ENDGAME_MAGIC 0xC4E4D6A3E0DB0001ULL
+#define ENDGAME_RECORDS_MAGIC 0xC4E4D6A3E0DB5EC0ULL
+#define ENDGAME_VERSION 2u
+#define ENDGAME_KEYS (INITIAL_HASH ^ ZOBRIST_SEED)
+
+#define ENDGAME_MAX_LEVELS 32u      // Levels of the hash, keys left after the last one are stored apart
+#define ENDGAME_GAMMA 2u            // Bits of every level for each key that reaches it
+#define ENDGAME_BLOCK_BITS 512u     // Bits counted by each rank counter
+
+// Move count from which the exact solver probes the database by default, the same
+// at which evaluateBoard() switches to a full solve.
+#define ENDGAME_DEFAULT_MOVES 30
+
+// Memory used by default by the table of the database builder, in megabytes.
+#define ENDGAME_DEFAULT_MEMORY_MB 256
+
+/*
+-------------------------------------------------------------------------------------------------------
+Hash functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Kind of keys stored in a database, the keys of every board type are different.
+// Compact boards have no hash member, their keys are computed from the bitmaps.
+template<typename BoardType>
+static constexpr uint32_t endgameKind()
+{
+    constexpr bool compact = !requires(BoardType board) { board.hash; };
+    return (uint32_t)BoardType::WIDTH | (uint32_t)BoardType::HEIGHT << 8 | (uint32_t)compact << 16;
+}
+
+// Mixes the key with the seed of a level of the hash, murmur3 finalizer.
+static inline uint64_t _endgameMix(uint64_t key, uint64_t seed)
+{
+    key += seed;
+    key = (key ^ (key >> 33)) * 0xFF51AFD7ED558CCDULL;
+    key = (key ^ (key >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+    return key ^ (key >> 33);
+}
+
+// Returns the bit of a key inside a level of the given bits.
+static inline uint64_t _endgameBit(uint64_t key, unsigned level, uint64_t bits)
+{
+    return _endgameMix(key, (level + 1) * 0x9E3779B97F4A7C15ULL) % bits;
+}
+
+// Returns the fingerprint of a key, it uses a seed that no level uses.
+static inline uint32_t _endgameFingerprint(uint64_t key)
+{
+    return (uint32_t)(_endgameMix(key, 0xD6E8FEB86659FD93ULL) >> 32);
+}
+
+/*
+-------------------------------------------------------------------------------------------------------
+Endgame database structures
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Header at the start of every database file, it is followed by:
+// - The bits of every level, one after the other, in 64-bit words.
+// - The rank counters, bits set before every block of ENDGAME_BLOCK_BITS, plus the total.
+// - The fingerprints and then the scores of the positions, by their index.
+// - The positions left after the last level, as EndgameRecords sorted by key.
+// Every part starts at a multiple of 8 bytes.
+struct EndgameHeader
+{
+    uint64_t magic = ENDGAME_MAGIC;
+    uint32_t version = ENDGAME_VERSION;
+    uint32_t kind = 0;                          // Kind of keys, see endgameKind()
+    uint64_t keys = ENDGAME_KEYS;
+    uint64_t count = 0;                         // Positions indexed by the hash
+    uint64_t extra = 0;                         // Positions stored apart
+    uint64_t levels = 0;                        // Levels of the hash
+    uint64_t levelBits[ENDGAME_MAX_LEVELS] = {};// Bits of every level, multiple of ENDGAME_BLOCK_BITS
+};
+
+// A solved position, as collected and as stored apart in the file.
+struct EndgameRecord
+{
+    uint64_t key;   // Key of the board, see boardKey()
+    int8_t score;   // Distance score, see distanceScore()
+};
+
+// Returns the index of the key in the hash, false if the key falls in no level.
+// The index is only meaningful for keys of the database, the rest are told apart
+// by their fingerprint.
+static inline bool _endgameIndex(const EndgameHeader& header, const uint64_t* words, const uint64_t* ranks, uint64_t key, uint64_t& index)
+{
+    uint64_t base = 0;
+
+    for (unsigned level = 0; level < header.levels; level++)
+    {
+        const uint64_t bit = base + _endgameBit(key, level, header.levelBits[level]);
+        const uint64_t word = bit >> 6;
+
+        if ((words[word] >> (bit & 63)) & 1)
+        {
+            index = ranks[bit / ENDGAME_BLOCK_BITS];
+            for (uint64_t w = bit / ENDGAME_BLOCK_BITS * (ENDGAME_BLOCK_BITS / 64); w < word; w++)
+                index += std::popcount(words[w]);
+            index += std::popcount(words[word] & ((1ULL << (bit & 63)) - 1));
+            return true;
+        }
+        base += header.levelBits[level];
+    }
+    return false;
+}
+
+// This structure holds an endgame database mapped from its file. Probes only read
+// the mapped memory, so it can be shared by any number of threads once opened.
+struct EndgameDatabase
+{
+private:
+    void* mapping = nullptr;                // Database file mapped in memory
+    size_t bytes = 0;                       // Size of the mapped file
+    const EndgameHeader* header = nullptr;  // Header at the start of the file
+    const uint64_t* words = nullptr;        // Bits of the levels
+    const uint64_t* ranks = nullptr;        // Rank counters of the bits
+    const uint32_t* fingerprints = nullptr; // Fingerprint of every position
+    const int8_t* scores = nullptr;         // Score of every position
+    const EndgameRecord* extra = nullptr;   // Positions stored apart
+    unsigned char fromMoves = ENDGAME_DEFAULT_MOVES; // Move count from which the solvers probe it
+
+public:
+    EndgameDatabase() = default;
+    inline ~EndgameDatabase()
+    {
+        close();
+    }
+
+    // No copies of a database are allowed, it owns its mapping.
+    EndgameDatabase(const EndgameDatabase&) = delete;
+    // No copies of a database are allowed, it owns its mapping.
+    EndgameDatabase& operator=(const EndgameDatabase&) = delete;
+
+    // Maps the given database file, closing the current one. The solvers given the database
+    // probe the boards with at least from_moves pieces. Returns false if the file is not a
+    // valid database, in that case no database is left open.
+    inline bool open(const char* filename, unsigned char from_moves = ENDGAME_DEFAULT_MOVES)
+    {
+        close();
+
+        size_t file_bytes = 0;
+        void* file = VirtualMemory::map_file(filename, file_bytes, false);
+        const EndgameHeader* head = (const EndgameHeader*)file;
+
+        if (!file || file_bytes < sizeof(EndgameHeader) || head->magic != ENDGAME_MAGIC || head->version != ENDGAME_VERSION ||
+            head->keys != ENDGAME_KEYS || head->levels > ENDGAME_MAX_LEVELS || head->count > file_bytes || head->extra > file_bytes)
+        {
+            VirtualMemory::unmap_file(file, file_bytes);
+            return false;
+        }
+
+        // The sizes are checked one by one so that a broken header can not overflow them.
+        bool valid = true;
+        uint64_t n_words = 0;
+        for (unsigned level = 0; valid && level < head->levels; level++)
+        {
+            valid = head->levelBits[level] && head->levelBits[level] % ENDGAME_BLOCK_BITS == 0 && head->levelBits[level] / 8 <= file_bytes;
+            n_words += valid ? head->levelBits[level] / 64 : 0;
+        }
+
+        const uint64_t n_ranks = n_words / (ENDGAME_BLOCK_BITS / 64) + 1;
+        const uint64_t fingerprints_bytes = (head->count * sizeof(uint32_t) + 7) / 8 * 8;
+        const uint64_t scores_bytes = (head->count + 7) / 8 * 8;
+        const uint64_t needed = sizeof(EndgameHeader) + (n_words + n_ranks) * sizeof(uint64_t) +
+            fingerprints_bytes + scores_bytes + head->extra * sizeof(EndgameRecord);
+
+        const uint64_t* level_words = (const uint64_t*)(head + 1);
+        const uint64_t* rank_words = level_words + n_words;
+
+        // The last rank counter is the number of positions indexed.
+        if (!valid || needed > file_bytes || rank_words[n_ranks - 1] != head->count)
+        {
+            VirtualMemory::unmap_file(file, file_bytes);
+            return false;
+        }
+
+        mapping = file;
+        bytes = file_bytes;
+        header = head;
+        words = level_words;
+        ranks = rank_words;
+        fingerprints = (const uint32_t*)(ranks + n_ranks);
+        scores = (const int8_t*)((const unsigned char*)fingerprints + fingerprints_bytes);
+        extra = (const EndgameRecord*)((const unsigned char*)scores + scores_bytes);
+        fromMoves = from_moves;
+        return true;
+    }
+
+    // Unmaps the database file if there is one.
+    inline void close()
+    {
+        VirtualMemory::unmap_file(mapping, bytes);
+
+        mapping = nullptr;
+        bytes = 0;
+        header = nullptr;
+    }
+
+    // Checks whether a database is open.
+    inline bool is_open() const
+    {
+        return header;
+    }
+
+    // Returns the kind of keys stored, see endgameKind().
+    inline uint32_t kind() const
+    {
+        return header ? header->kind : 0;
+    }
+
+    // Returns the number of positions in the database.
+    inline size_t size() const
+    {
+        return header ? (size_t)(header->count + header->extra) : 0;
+    }
+
+    // Returns the move count from which the solvers probe the database, see open().
+    inline unsigned char from_moves() const
+    {
+        return fromMoves;
+    }
+
+    // Checks whether the solvers should probe the database for the given board, it must
+    // be open, hold the keys of its board type and the board must have enough pieces.
+    template<typename BoardType>
+    inline bool covers(unsigned char moveCount) const
+    {
+        return header && moveCount >= fromMoves && header->kind == endgameKind<BoardType>();
+    }
+
+    // Looks for the key in the database, if found it copies its distance score and returns true.
+    // A key that is not in the database is only taken as found if its fingerprint matches,
+    // which happens once every 2^32 probes at most.
+    inline bool probe(uint64_t key, int8_t& score) const
+    {
+        uint64_t index;
+        if (_endgameIndex(*header, words, ranks, key, index))
+        {
+            if (fingerprints[index] != _endgameFingerprint(key))
+                return false;
+
+            score = scores[index];
+            return true;
+        }
+
+        // Binary search over the positions stored apart.
+        size_t low = 0;
+        size_t high = (size_t)header->extra;
+        while (low < high)
+        {
+            const size_t mid = low + (high - low) / 2;
+            if (extra[mid].key < key)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+
+        if (low == header->extra || extra[low].key != key)
+            return false;
+
+        score = extra[low].score;
+        return true;
+    }
+};
+
+// This structure collects solved positions and builds database files out of them.
+// The positions can be saved into a records file and loaded back, so the runs
+// can keep adding positions and the database is built from all of them.
+struct EndgameBuilder
+{
+private:
+    EndgameRecord* records = nullptr;   // Positions collected
+    size_t count = 0;                   // Number of positions collected
+    size_t capacity = 0;                // Positions that fit in records
+    uint32_t keyKind;                   // Kind of keys collected, see endgameKind()
+
+public:
+    inline EndgameBuilder(uint32_t kind) : keyKind{ kind } {}
+    ~EndgameBuilder();
+
+    // No copies of a builder are allowed, it owns its records.
+    EndgameBuilder(const EndgameBuilder&) = delete;
+    // No copies of a builder are allowed, it owns its records.
+    EndgameBuilder& operator=(const EndgameBuilder&) = delete;
+
+    // Returns the kind of keys collected, see endgameKind().
+    inline uint32_t kind() const
+    {
+        return keyKind;
+    }
+
+    // Returns the number of positions collected, repeated ones included.
+    inline size_t size() const
+    {
+        return count;
+    }
+
+    // Adds a solved position, returns false if there is no memory for it.
+    bool add(uint64_t key, int8_t score);
+
+    // Adds the positions of a records file to the ones collected.
+    // Returns false if the file is not a records file of the same kind of keys.
+    bool load(const char* records_file);
+
+    // Writes every position collected into a records file, overwriting it.
+    bool save(const char* records_file) const;
+
+    // Builds the database with every position collected and writes it into the file.
+    // Repeated positions are only stored once. Returns the number of positions
+    // written, 0 if there are none or the file could not be written.
+    size_t build(const char* database_file);
+};
+
+/*
+-------------------------------------------------------------------------------------------------------
+Endgame building functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Solves the given number of random positions of the engine Board with the given moves played,
+// adds them to the records file and builds the database file from every position recorded, so
+// every run grows the database. The records file is created if it does not exist. The positions
+// are drawn from the seed (0 uses the clock) and solved by the distance solver with a table of
+// memory_mb megabytes. Returns the number of positions in the database, 0 if the files could
+// not be read or written.
+extern size_t buildEndgameDatabase(const char* database_file, const char* records_file, size_t positions, unsigned char moves = ENDGAME_DEFAULT_MOVES, size_t memory_mb = ENDGAME_DEFAULT_MEMORY_MB, uint64_t seed = 0);
@@ -7,6 +7,10 @@
 -------------------------------------------------------------------------------------------------------
 This header includes functions to numerically evaluate a board position
 this funtions will return the SolveEval struct, with the values listed below.
+
+Like the bit-solver, the functions are templated over the board representation
+and size, and instantiated for Board, Board7x6 and CompactBoard7x6 in
+heuristicSolver.cpp. The 8x8 CompactBoard has no unique keys, see _compactKey().
 -------------------------------------------------------------------------------------------------------
 -------------------------------------------------------------------------------------------------------
 */
@@ -45,6 +49,7 @@ struct HeuristicData
 {
 	HeuristicTransTable* HTT = nullptr;					// Stores the heuristic tree transposition table
 	TransTable* TT = nullptr;							// Stores the exact tree transposition table
+	const EndgameDatabase* ENDGAME = nullptr;			// Endgame database probed by the exact tree, if any
 
 	bool* STOP = nullptr;								// Bool* to cancel the tree generation from a different thread
 
@@ -70,8 +75,10 @@ struct HeuristicData
 //
 // Use of this function in particular is only intended for direct interaction by engines.
 // For user-end use is safer to use the other functions.
-extern inline float heuristicTree(Board& board, float alpha, float beta, unsigned char depth, const HeuristicData& DATA);
+template<typename BoardType>
+extern float heuristicTree(BoardType& board, float alpha, float beta, unsigned char depth, const HeuristicData& DATA);
 
 // This will return all the information above after processing a tree of the board to a given depth.
 // Every heuristic function call will check for wins using the bitSoler to a given bitDepth.
-extern SolveEval evaluateBoard(const Board& initialBoard, unsigned char depth, HeuristicData const* DATA = nullptr);
+template<typename BoardType>
+extern SolveEval evaluateBoard(const BoardType& initialBoard, unsigned char depth, HeuristicData const* DATA = nullptr);
@@ -3,6 +3,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <atomic>
+#include <cmath>		// For std::floor() and std::ceil()
+#include <bit>		// For std::bit_floor(), std::has_single_bit(), std::popcount() and std::countr_zero()
+#include "VirtualMemory.h"	// For the table memory, with large pages when available
+#include "snapshot.h"		// For saving the table and mapping it back
+#include "ttstats.h"		// For the table statistics
+#include <xmmintrin.h>	// For _mm_prefetch()
 
 /* HEURISTIC TRANSPOSITION TABLE HEADER FILE
 -------------------------------------------------------------------------------------------------------
@@ -21,16 +27,13 @@ Macros for HTTs
 
 #define _HEURISTIC_TT
 
-// Number of entries that will be created by defaul in a transposition table.
+// Memory used by default by a heuristic transposition table, in bytes.
 // 
-// The solver generates a TT for every moveCount that it analises. That way it avoids 
-// overriding hot boards of different depths. But that comes at the cost of a lor of 
-// memory usage. 
-// The number below seems to be the perfect balance between maintaining hot paths 
-// avaliable on the TT and not making it too big for the program to search for
-// different entries. Modify with caution.
+// A single table is shared by every moveCount, its replacement policy takes care of 
+// keeping the hot boards of the current search, see HeuristicTransTable::probe(). 
+// The engines size their tables from the memory budget they are given.
 
-#define HTT_SIZE 0x4000ULL // 3/8 MB (16384 entries)
+#define HTT_DEFAULT_SIZE (8ULL << 20) // 8 MB (512K entries)
 
 // Flags for defining the type of entry depending on the kind of information
 // we have about the Board score.
@@ -40,6 +43,94 @@ Macros for HTTs
 #define ENTRY_FLAG_LOWER 1u
 #define ENTRY_FLAG_UPPER 2u
 
+// Generations of the table entries go from 1 to HTT_GENERATIONS, an empty slot is 
+// generation 0, so it is never found. See HeuristicTransTable::clear().
+
+#define HTT_GENERATIONS 15u
+
+// Evaluations are stored as 16-bit fixed point numbers with this scale, so the ones
+// between -8 and +8 are kept to 1/4096. Wins, losses and multiples of POINT_DISTANCE
+// are stored exactly. Bounds are rounded outwards so they stay valid, see _encodeEval().
+
+#define HTT_EVAL_SCALE 4096.f
+#define HTT_EVAL_LIMIT 32767.f
+
+/*
+-------------------------------------------------------------------------------------------------------
+Entry encoding functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Weight of every position of a move order in its index, the factorial of the columns left after it.
+static constexpr uint16_t _HTT_ORDER_WEIGHTS[8] = { 5040, 720, 120, 24, 6, 2, 1, 1 };
+
+// Returns the index of a move order among the 8! orders of the columns (its Lehmer code),
+// which fits in 16 bits. A column that is repeated or out of range is taken as the lowest
+// one left, so every order is stored as a valid one.
+static inline uint16_t _encodeOrder(const uint8_t order[8])
+{
+    unsigned left = 0xFFu;
+    unsigned index = 0;
+
+    for (unsigned i = 0; i < 7; i++)
+    {
+        unsigned bit = 1u << (order[i] & 7u);
+        if (order[i] > 7 || !(left & bit))
+            bit = left & (0u - left);
+
+        index += std::popcount(left & (bit - 1)) * _HTT_ORDER_WEIGHTS[i];
+        left &= ~bit;
+    }
+
+    return (uint16_t)index;
+}
+
+// Writes the move order of the given index, see _encodeOrder().
+static inline void _decodeOrder(unsigned index, uint8_t order[8])
+{
+    unsigned left = 0xFFu;
+    index %= 40320u;
+
+    for (unsigned i = 0; i < 8; i++)
+    {
+        unsigned digit = index / _HTT_ORDER_WEIGHTS[i];
+        index -= digit * _HTT_ORDER_WEIGHTS[i];
+
+        // The column is the one with as many columns left below it as the digit.
+        unsigned higher = left;
+        while (digit--)
+            higher &= higher - 1;
+
+        order[i] = (uint8_t)std::countr_zero(higher);
+        left &= ~(1u << order[i]);
+    }
+}
+
+// Returns the evaluation as a 16-bit fixed point number, see HTT_EVAL_SCALE.
+// Exact evaluations are rounded to the nearest step, lower bounds down and upper bounds up,
+// so a stored bound never claims more than the search proved.
+static inline uint16_t _encodeEval(float eval, uint8_t flag)
+{
+    float scaled = eval * HTT_EVAL_SCALE;
+    if (scaled > HTT_EVAL_LIMIT) scaled = HTT_EVAL_LIMIT;
+    if (scaled < -HTT_EVAL_LIMIT) scaled = -HTT_EVAL_LIMIT;
+
+    if (flag == ENTRY_FLAG_LOWER)
+        scaled = std::floor(scaled);
+    else if (flag == ENTRY_FLAG_UPPER)
+        scaled = std::ceil(scaled);
+    else
+        scaled = scaled < 0.f ? scaled - 0.5f : scaled + 0.5f;
+
+    return (uint16_t)(int16_t)scaled;
+}
+
+// Returns the evaluation of a 16-bit fixed point number, see HTT_EVAL_SCALE.
+static inline float _decodeEval(uint16_t bits)
+{
+    return (float)(int16_t)bits * (1.f / HTT_EVAL_SCALE);
+}
+
 /*
 -------------------------------------------------------------------------------------------------------
 Transposition Table and its Entries defintion
@@ -49,6 +140,11 @@ Transposition Table and its Entries defintion
 // This structure defines an entry of the transposition table, stores the current information known
 // about a board, used for referencing while generating trees and for user evaluations. The board is 
 // encoded as a hash value and it saves depths, best move order, and current evaluation.
+// 
+// Inside the table the entry is packed in two words, see HTTSlot. This is the copy the table 
+// hands out when a board is found, and the one that is written back when modified, so the
+// solvers read and modify the fields of the copy and never the packed words. The copy keeps
+// the packed word it was read from, so set() can tell if the board was written meanwhile.
 struct HTTEntry
 {
     uint64_t key;           // full key
@@ -57,67 +153,148 @@ struct HTTEntry
     uint8_t  heuDepth;      // remaining heuristic depth stored
     uint8_t  bitDepth;      // exact tree depth stored
     uint8_t  flag;          // 0=EXACT, 1=LOWER, 2=UPPER
-private:
-    std::atomic_flag _lock; // To lock the entry while writing/reading
-public:
+    uint8_t  moveCount;     // Moves played on the stored board
+    uint64_t data;          // packed word the entry was read from, 0 if it was not stored
 
-    inline void lock() noexcept
+    // Ply up to which the entry was searched heuristically. Entries left by older
+    // roots or shallower iterations have a lower horizon.
+    inline unsigned horizon() const
     {
-        while (_lock.test_and_set(std::memory_order_acquire)) { /* busy waiting */ }
+        return (unsigned)moveCount + heuDepth;
     }
-    inline void unlock() noexcept
+};
+
+// This structure is a slot of the table, it holds an entry packed in two 64-bit words that are 
+// read and written one by one without any lock. The first word is the key xored with the 
+// other one, so a reader that gets words from different writes obtains a key that does 
+// not match and sees the slot as empty. Readers never wait and writers never block them, 
+// a race between two writers can only lose one of the stores.
+// 
+// The move order is stored as its index among every order (see _encodeOrder()) and the
+// evaluation as a fixed point number (see _encodeEval()), so the slot takes 16 bytes and
+// both slots of a key share a cache line.
+struct HTTSlot
+{
+    std::atomic<uint64_t> check;    // key ^ data
+    std::atomic<uint64_t> data;     // eval | order | heuDepth | bitDepth | flag, generation | moveCount
+
+    // Copies the entry stored in the slot and returns its generation.
+    // The key is only valid if the words were not torn.
+    inline uint8_t load(HTTEntry& entry) const
     {
-        _lock.clear(std::memory_order_release);
+        const uint64_t d = data.load(std::memory_order_relaxed);
+
+        entry.data = d;
+        entry.key = check.load(std::memory_order_relaxed) ^ d;
+        entry.eval = _decodeEval((uint16_t)d);
+        _decodeOrder((uint16_t)(d >> 16), entry.order);
+        entry.heuDepth = (uint8_t)(d >> 32);
+        entry.bitDepth = (uint8_t)(d >> 40);
+        entry.flag = (uint8_t)(d >> 48) & 0x3u;
+        entry.moveCount = (uint8_t)(d >> 54) & 0x7Fu;
+
+        return (uint8_t)(d >> 50) & 0xFu;
     }
 
-    inline void set(const uint64_t _key, const uint8_t _order[8], const float _eval, const uint8_t _heuDepth, const uint8_t _bitDepth, const uint8_t _flag)
+    // Packs the given entry with the given generation into the data word.
+    static inline uint64_t pack(const HTTEntry& entry, uint8_t generation)
     {
-        lock();
+        return (uint64_t)_encodeEval(entry.eval, entry.flag)
+            | (uint64_t)_encodeOrder(entry.order) << 16
+            | (uint64_t)entry.heuDepth << 32
+            | (uint64_t)entry.bitDepth << 40
+            | (uint64_t)(entry.flag & 0x3u) << 48
+            | (uint64_t)(generation & 0xFu) << 50
+            | (uint64_t)(entry.moveCount & 0x7Fu) << 54;
+    }
 
-        eval = _eval;
-        heuDepth = _heuDepth;
-        bitDepth = _bitDepth;
-        flag = _flag;
-        order[0] = _order[0];
-        order[1] = _order[1];
-        order[2] = _order[2];
-        order[3] = _order[3];
-        order[4] = _order[4];
-        order[5] = _order[5];
-        order[6] = _order[6];
-        order[7] = _order[7];
-        key = _key;
+    // Writes the given entry into the slot with the given generation.
+    inline void store(const HTTEntry& entry, uint8_t generation)
+    {
+        const uint64_t d = pack(entry, generation);
 
-        unlock();
+        data.store(d, std::memory_order_relaxed);
+        check.store(entry.key ^ d, std::memory_order_relaxed);
     }
-    inline void set(const uint64_t _key, const uint8_t _bestCol, const float _eval, const uint8_t _heuDepth, const uint8_t _bitDepth, const uint8_t _flag)
-    {
-        lock();
 
-        eval = _eval;
-        heuDepth = _heuDepth;
-        bitDepth = _bitDepth;
-        flag = _flag;
-        order[0] = _bestCol;
-        order[1] = 255; // for debugging (if ever analized will raise error)
-        key = _key;
+    // Writes the packed word d of the given key only if the data word of the slot is still
+    // the expected one, returns false if another store got there first and nothing was written.
+    inline bool replace(uint64_t key, uint64_t d, uint64_t expected)
+    {
+        if (!data.compare_exchange_strong(expected, d, std::memory_order_relaxed))
+            return false;
 
-        unlock();
+        check.store(key ^ d, std::memory_order_relaxed);
+        return true;
     }
 };
 
-// This structure defines our tranposition table, it stores an array of 2^n entries.
-// Each board can acces an entry of the array masking their key (hash).
+static_assert(sizeof(HTTSlot) == 16, "Both slots of a key must fit in a cache line");
+
+// This structure defines our tranposition table, it stores an array of 2^n slots.
+// Each board can acces a slot of the array masking their key (hash).
+// A single table holds the boards of every moveCount, sized by a memory budget.
 struct HeuristicTransTable 
 {
 private:
-    HTTEntry* entries = nullptr;    // Entries of the Transposition Table
-    uint32_t mask;                  // Mask used to link a key/hash with an entry
+    HTTSlot* slots = nullptr;       // Slots of the Transposition Table
+    uint64_t mask;                  // Mask used to link a key/hash with a slot
+    size_t pageSize = 0;            // Size of the pages backing the slots
+    void* mapping = nullptr;        // Snapshot file the slots are mapped from, see map()
+    size_t mappingBytes = 0;        // Size of the mapped snapshot file
+    bool readOnly = false;          // Whether the mapped slots can be written
+    bool shared = false;            // Whether the slots belong to another table, see share()
+    uint8_t generation = 1;         // Generation of the live entries, see clear()
+    uint8_t floor = 0;              // Entries with less moves are replaced first, see set_floor()
+    uint64_t salt = 0;              // Xored into every key of a shared view, see share()
+    const HeuristicTransTable* base = nullptr; // Table read below this one, see fork()
+#ifdef _TT_STATS
+    mutable TTCounters counters;    // Probes and stores counted, see stats()
+#endif
+
+    // This function sets to zero the entire transposition table and starts the first generation.
+    // Big tables are cleared by several threads, see VirtualMemory::clear().
+    inline void wipe()
+    {
+        VirtualMemory::clear((void*)slots, size(), pageSize);
+        generation = 1;
+    }
+
+    // Clears an entry that does not count as stored. The data word of its slot is kept,
+    // so set() can still check that nobody wrote the slot before replacing it.
+    static inline void empty(HTTEntry& entry)
+    {
+        const uint64_t data = entry.data;
+        entry = {};
+        entry.data = data;
+    }
+
+    // Copies the entry of a slot, entries of older generations are seen as empty.
+    inline void read(const HTTSlot& slot, HTTEntry& entry) const
+    {
+        if (slot.load(entry) != generation)
+            empty(entry);
+    }
+
+#ifdef _TT_STATS
+    // Counts a store of the key that found the entry e in its slot, see stats().
+    inline void count_store(uint64_t key, const HTTEntry& e, bool written, uint8_t moveCount) const
+    {
+        if (e.key != key)
+        {
+            counters.count(moveCount, TTCounters::INSERTS);
+            if (e.key)
+                counters.count(moveCount, TTCounters::COLLISIONS);
+        }
+        else
+            counters.count(moveCount, written ? TTCounters::UPDATES : TTCounters::REFUSED);
+    }
+#endif
 
 public:
-    inline HeuristicTransTable(size_t pow2_entries = HTT_SIZE)
+    inline HeuristicTransTable(size_t bytes = HTT_DEFAULT_SIZE)
     {
-        init(pow2_entries);
+        init(bytes);
     }
     inline ~HeuristicTransTable()
     {
@@ -127,88 +304,345 @@ public:
     // Checks wether the entries have been created or not.
     inline bool is_init()
     {
-        if (entries)
+        if (slots)
             return true;
         return false;
     }
 
-    // This function initialises the transposition table to a given length.
-    // The lenght must be a power of 2 for the mask to work properly.
-    inline void init(size_t pow2_entries = HTT_SIZE)
+    // This function initialises the transposition table to fit in the given bytes.
+    // The number of slots is rounded down to a power of 2 for the mask to work properly.
+    inline void init(size_t bytes = HTT_DEFAULT_SIZE)
+    {
+        erase();
+
+        // The 2-slot bucket needs at least two slots.
+        size_t pow2_slots = bytes / sizeof(HTTSlot);
+        if (pow2_slots < 2)
+            pow2_slots = 2;
+        pow2_slots = std::bit_floor(pow2_slots);
+
+        slots = (HTTSlot*)VirtualMemory::allocate(sizeof(HTTSlot) * pow2_slots, pageSize);
+        mask = slots ? pow2_slots - 1 : 0;
+        if (slots)
+            wipe();
+    }
+
+    // Returns the memory used by the entries in bytes.
+    inline size_t size() const
     {
-        if (entries)
-            free(entries);
+        return slots ? sizeof(HTTSlot) * (mask + 1) : 0;
+    }
 
-        entries = (HTTEntry*)calloc(sizeof(HTTEntry), pow2_entries);
-        mask = (uint32_t)(pow2_entries - 1);
+    // Returns the size of the pages backing the table, to know if large pages were obtained.
+    inline size_t page_size() const
+    {
+        return slots ? pageSize : 0;
     }
 
-    // This function sets to zero the entire transposition table.
+    // This function empties the transposition table by starting a new generation, the entries 
+    // of older ones are not found anymore and are the first to be replaced. Only when the
+    // generations run out the memory is swept, once every HTT_GENERATIONS calls.
     inline void clear()
     {
-        if (!entries)
+        if (!slots || readOnly || shared)
             return;
 
-        memset(entries, 0U, sizeof(HTTEntry) * (mask + 1));
+        if (generation < HTT_GENERATIONS)
+            generation++;
+        else
+            wipe();
+    }
+
+    // Makes the table an overlay of the parent, see TransTable::fork(). Entries found in the
+    // parent and modified with set() are written in this table.
+    inline void fork(const HeuristicTransTable* parent)
+    {
+        base = parent != this ? parent : nullptr;
+    }
+
+    // Sets the move count of the root of the search, see TransTable::set_floor().
+    inline void set_floor(uint8_t moveCount)
+    {
+        floor = shared ? 0 : moveCount;
     }
 
     // This function erases the memory of the transposition table.
+    // A shared view only lets go of the slots, they belong to the shared table.
     inline void erase()
     {
-        if (!entries)
+        if (!slots)
+            return;
+
+        if (mapping)
+            VirtualMemory::unmap_file(mapping, mappingBytes);
+        else if (!shared)
+            VirtualMemory::release(slots, size(), pageSize);
+
+        slots = nullptr;
+        mapping = nullptr;
+        readOnly = false;
+        shared = false;
+        salt = 0;
+        floor = 0;
+    }
+
+    // Turns this table into a view of the slots of another one, releasing its own, see
+    // TransTable::share(). Entries handed out by a salted view carry the key of the board,
+    // the salt is only applied inside the table.
+    inline void share(const HeuristicTransTable& table, uint64_t owner = 0)
+    {
+        erase();
+        if (!table.slots)
             return;
 
-        free(entries);
-        entries = nullptr;
+        slots = table.slots;
+        mask = table.mask;
+        pageSize = table.pageSize;
+        readOnly = table.readOnly;
+        generation = table.generation;
+        shared = true;
+        salt = owner * 0x9E3779B97F4A7C15ULL;
+    }
+
+    // Returns the table memory as a snapshot section, to be saved with saveSnapshot().
+    inline SnapshotTable snapshot() const
+    {
+        return { { SNAPSHOT_HTT, sizeof(HTTSlot), 0, size(), generation }, slots };
+    }
+
+    // Maps the table stored in a snapshot file in place of the current one, see snapshot.h.
+    // If copy_on_write the table works as usual and the file is never modified, otherwise
+    // the table is read-only and stores are ignored. Returns false if the table is not found.
+    inline bool map(const char* filename, bool copy_on_write = true)
+    {
+        size_t bytes = 0;
+        void* file = VirtualMemory::map_file(filename, bytes, copy_on_write);
+        const SnapshotSection* section = findSnapshotSection(file, bytes, SNAPSHOT_HTT, sizeof(HTTSlot));
+
+        // The number of slots must be a power of 2 for the mask to work properly.
+        if (!section || section->bytes % sizeof(HTTSlot) || !std::has_single_bit(section->bytes / sizeof(HTTSlot)) ||
+            !section->generation || section->generation > HTT_GENERATIONS)
+        {
+            VirtualMemory::unmap_file(file, bytes);
+            return false;
+        }
+
+        erase();
+        slots = (HTTSlot*)((unsigned char*)file + section->offset);
+        mask = section->bytes / sizeof(HTTSlot) - 1;
+        pageSize = VirtualMemory::system_page_size();
+        mapping = file;
+        mappingBytes = bytes;
+        readOnly = !copy_on_write;
+        generation = (uint8_t)section->generation;
+        return true;
     }
 
-    // Checks to  see if the board position is stored in the table.
-    // If so, returns the pointer, otherwise returns nullptr.
-    inline HTTEntry* storedBoard(uint64_t key) const
+    // Checks to see if the board position is stored in the table.
+    // If so, it copies the entry and returns true, otherwise returns false.
+    inline bool storedBoard(uint64_t key, HTTEntry& entry) const
     {
-        HTTEntry* e0 = &entries[key & mask];
-        if (e0->key == key) return e0;
-        HTTEntry* e1 = &entries[(key & mask) ^ 1];
-        if (e1->key == key) return e1;
+#ifdef _TT_STATS
+        counters.probe();
+#endif
+        key ^= salt;
+        read(slots[key & mask], entry);
+        if (entry.key != key)
+            read(slots[(key & mask) ^ 1], entry);
+        if (entry.key != key)
+        {
+            entry.data = 0;
+            return base && base->storedBoard(key ^ salt, entry);
+        }
+
+        entry.key ^= salt;
+
+#ifdef _TT_STATS
+        counters.count(entry.moveCount, TTCounters::HITS);
+#endif
+        return true;
+    }
 
-        return nullptr;
+    // Asks the processor to bring both slots of the key into the cache, so a later probe
+    // does not wait for memory. The pair is aligned to its size, so it is a single line.
+    inline void prefetch(uint64_t key) const
+    {
+        _mm_prefetch((const char*)&slots[(key ^ salt) & mask & ~1ULL], _MM_HINT_T0);
+        if (base)
+            base->prefetch(key);
     }
 
-    // This function returns the pointer to an entry of the table given a certain key.
+    // This function returns the slot of the table for a given key and copies its entry.
     // To choose the position it choses between the masked key or its tggled one,
     // allowing for better collision management. It is called 2-slot bucket.
-    inline HTTEntry* probe(uint64_t key) const
+    // 
+    // The victim is the entry with the lowest horizon (moveCount + heuDepth), which evicts
+    // boards left by previous roots first, and then the one with the lowest depth.
+    // Entries of older generations are seen as empty, so they go first, and so are the
+    // ones of boards with less moves than the floor, see set_floor().
+    inline HTTSlot* probe(uint64_t key, HTTEntry& entry) const
     {
-        HTTEntry* e0 = &entries[key & mask];
-        if (e0->key == key) return e0;
-        HTTEntry* e1 = &entries[(key & mask) ^ 1];
-        if (e1->key == key) return e1;
+        HTTSlot* s0 = &slots[key & mask];
+        HTTSlot* s1 = &slots[(key & mask) ^ 1];
+
+        HTTEntry e1;
+        read(*s0, entry);
+        if (entry.key == key) return s0;
+        read(*s1, e1);
+        if (e1.key == key)
+        {
+            entry = e1;
+            return s1;
+        }
+
+        if (entry.moveCount < floor) empty(entry);
+        if (e1.moveCount < floor) empty(e1);
+
+        if (e1.horizon() < entry.horizon() || (e1.horizon() == entry.horizon() && e1.heuDepth < entry.heuDepth))
+        {
+            entry = e1;
+            return s1;
+        }
+        return s0;
+    }
 
-        // choose a victim by lower depth (or empty)
-        return (e0->heuDepth <= e1->heuDepth) ? e0 : e1;
+    // This function writes the given entry in its slot of the table. Used to modify entries
+    // obtained with storedBoard(), so it only writes if the board was not stored again since
+    // the entry was read. Otherwise the entry is replaced by the stored one and it returns
+    // false, the caller has to apply its changes again and retry.
+    inline bool set(HTTEntry& entry) const
+    {
+        if (readOnly)
+            return true;
+
+        HTTEntry salted = entry;
+        salted.key ^= salt;
+
+        for (;;)
+        {
+            HTTEntry stored;
+            HTTSlot* slot = probe(salted.key, stored);
+
+            // The board was written since it was read, hand back what is there now.
+            if (stored.key == salted.key && stored.data != entry.data)
+            {
+                entry = stored;
+                entry.key ^= salt;
+                return false;
+            }
+
+            // If the slot changed before the write the slot is probed again.
+            const uint64_t d = HTTSlot::pack(salted, generation);
+            if (slot->replace(salted.key, d, stored.data))
+            {
+                entry.data = d;
+                return true;
+            }
+        }
     }
 
     // This function receives a TTentry and stores it inside te transposition table.
-    inline float store(uint64_t key, uint8_t order[8], float eval, uint8_t heuDepth, uint8_t bitDepth, uint8_t flag) const
+    inline float store(uint64_t key, const uint8_t order[8], float eval, uint8_t heuDepth, uint8_t bitDepth, uint8_t flag, uint8_t moveCount) const
     {
-        HTTEntry* e = probe(key);
+        if (readOnly)
+            return eval;
+
+        key ^= salt;
+        HTTEntry e;
+        HTTSlot* slot = probe(key, e);
 
         // If keys are different or you are deeper and no victory found
-        if (e->key != key || (heuDepth >= e->heuDepth && e->eval != -1.f && e->eval != 1.f) || eval == 1.f || eval == -1.f)
-            e->set(key, order, eval, heuDepth, bitDepth, flag);
+        const bool replace = e.key != key || (heuDepth >= e.heuDepth && e.eval != -1.f && e.eval != 1.f) || eval == 1.f || eval == -1.f;
+#ifdef _TT_STATS
+        count_store(key, e, replace, moveCount);
+#endif
+        if (replace)
+        {
+            e.key = key;
+            memcpy(e.order, order, sizeof(e.order));
+            e.eval = eval;
+            e.heuDepth = heuDepth;
+            e.bitDepth = bitDepth;
+            e.flag = flag;
+            e.moveCount = moveCount;
+            slot->store(e, generation);
+        }
 
         return eval;
     }
 
     // This function receives a TTentry and stores it inside te transposition table.
-    inline float store(uint64_t key, uint8_t bestCol, float eval, uint8_t heuDepth, uint8_t bitDepth, uint8_t flag) const
+    // Only the best column is known, the rest of the order stays as it was in the slot,
+    // or as the columns go for a new board.
+    inline float store(uint64_t key, uint8_t bestCol, float eval, uint8_t heuDepth, uint8_t bitDepth, uint8_t flag, uint8_t moveCount) const
     {
-        HTTEntry* e = probe(key);
+        if (readOnly)
+            return eval;
+
+        key ^= salt;
+        HTTEntry e;
+        HTTSlot* slot = probe(key, e);
 
         // If keys are different or you are deeper and no victory found
-        if (e->key != key || (heuDepth >= e->heuDepth && e->eval != -1.f && e->eval != 1.f) || eval == 1.f || eval == -1.f)
-            e->set(key, bestCol, eval, heuDepth, bitDepth, flag);
+        const bool replace = e.key != key || (heuDepth >= e.heuDepth && e.eval != -1.f && e.eval != 1.f) || eval == 1.f || eval == -1.f;
+#ifdef _TT_STATS
+        count_store(key, e, replace, moveCount);
+#endif
+        if (replace)
+        {
+            if (e.key != key)
+                for (uint8_t c = 0; c < 8; c++)
+                    e.order[c] = c;
+
+            for (uint8_t c = 0; c < 8; c++)
+                if (e.order[c] == bestCol)
+                    e.order[c] = e.order[0];
+
+            e.key = key;
+            e.order[0] = bestCol;
+            e.eval = eval;
+            e.heuDepth = heuDepth;
+            e.bitDepth = bitDepth;
+            e.flag = flag;
+            e.moveCount = moveCount;
+            slot->store(e, generation);
+        }
 
         return eval;
     }
+
+    // Returns the statistics of the table. The entries are counted by scanning the whole
+    // table, the rest only if _TT_STATS is defined, see ttstats.h.
+    inline TTStats stats() const
+    {
+        TTStats stats;
+#ifdef _TT_STATS
+        counters.copy(stats);
+#endif
+        if (!slots)
+            return stats;
+
+        stats.capacity = mask + 1;
+
+        HTTEntry e;
+        for (uint64_t i = 0; i <= mask; i++)
+        {
+            read(slots[i], e);
+            if (!e.key)
+                continue;
+
+            stats.moves[e.moveCount < TT_STATS_MOVES ? e.moveCount : TT_STATS_MOVES - 1].entries++;
+            stats.entries++;
+        }
+
+        return stats;
+    }
+
+    // Sets the counters of the table statistics back to zero, see stats().
+    inline void reset_stats() const
+    {
+#ifdef _TT_STATS
+        counters.reset();
+#endif
+    }
 };
\ No newline at end of file
@@ -97,6 +97,34 @@ inline constexpr uint64_t Row7 = 0x8080808080808080ULL; // Mask for the row 7
 
 #pragma endregion
 
+#pragma region // Masks for boards of any size up to 8x8, generated at compile time.
+
+// Every column keeps a stride of 8 bits whatever the size of the board is, so the shifts
+// and the border masks in this file are valid for any board that fits in the 8x8 grid.
+// Only the cells that actually exist depend on the size, anything computed with the
+// 8x8 masks that could land outside of the board is then cut with BOARD_AREA.
+
+constexpr uint64_t _generate_area_mask(const unsigned char width, const unsigned char height)
+{
+	uint64_t area = 0ULL;
+
+	for (unsigned char column = 0; column < width; column++)
+		area |= ((1ULL << height) - 1) << (column * 8);
+
+	return area;
+}
+
+template<unsigned char WIDTH, unsigned char HEIGHT>
+inline constexpr uint64_t BOARD_AREA = _generate_area_mask(WIDTH, HEIGHT);				// Every cell of the board
+
+template<unsigned char WIDTH, unsigned char HEIGHT>
+inline constexpr uint64_t BOARD_BOTTOM = Row0 & BOARD_AREA<WIDTH, HEIGHT>;				// Floor cells of the board
+
+template<unsigned char WIDTH, unsigned char HEIGHT>
+inline constexpr uint64_t BOARD_TOP = ROW_MASK(HEIGHT - 1) & BOARD_AREA<WIDTH, HEIGHT>;	// Last row of the board
+
+#pragma endregion
+
 #pragma region // Masks for corners. To clear invalid shitings.
 
 inline constexpr uint64_t MASK_1NW = 0x00FEFEFEFEFEFEFEULL;
@@ -158,6 +186,42 @@ inline constexpr uint64_t MASK_3S = 0x1F1F1F1F1F1F1F1FULL; // To check win in ve
 
 #define COLLAPSE_ALL_WINNING_MOVES(M)    (TOTAL_COLLAPSE_DIAGONALNW(M) | TOTAL_COLLAPSE_DIAGONALSW(M) | TOTAL_COLLAPSE_HORIZONTAL(M))
 
+#define COLLAPSE_VERTICAL_3L(M)          (SHIFT_3_NORTH(M) & SHIFT_2_NORTH(M) & SHIFT_NORTH(M) & MASK_3N)
+#define COLLAPSE_VERTICAL_2L1R(M)        (SHIFT_2_NORTH(M) &   SHIFT_NORTH(M) & SHIFT_SOUTH(M) & MASK_2N & MASK_1S)
+#define COLLAPSE_VERTICAL_1L2R(M)        (  SHIFT_NORTH(M) &   SHIFT_SOUTH(M) & SHIFT_2_SOUTH(M) & MASK_1N & MASK_2S)
+#define COLLAPSE_VERTICAL_3R(M)          (  SHIFT_SOUTH(M) & SHIFT_2_SOUTH(M) & SHIFT_3_SOUTH(M) & MASK_3S)
+
+#define TOTAL_COLLAPSE_VERTICAL(M)       (COLLAPSE_VERTICAL_3L(M) | COLLAPSE_VERTICAL_2L1R(M) | COLLAPSE_VERTICAL_1L2R(M) | COLLAPSE_VERTICAL_3R(M))
+
+#pragma endregion
+
+#pragma region // Shifts and masks for the four directions at once (one direction per 64 bit lane).
+
+// Lanes are ordered as horizontal, vertical, diagonal SW and diagonal NW.
+// Forward shifts go left (EAST, NORTH, NE, SE) and backward shifts go right (WEST, SOUTH, SW, NW),
+// the first index is the distance - 1. Used by the AVX2 kernel to collapse all directions together.
+
+alignas(32) inline constexpr uint64_t DIRECTION_SHIFT[3][4] =
+{
+	{  8, 1,  9,  7 },
+	{ 16, 2, 18, 14 },
+	{ 24, 3, 27, 21 },
+};
+
+alignas(32) inline constexpr uint64_t DIRECTION_MASK_FORWARD[3][4] =
+{
+	{ MASK_1E, MASK_1N, MASK_1NE, MASK_1SE },
+	{ MASK_2E, MASK_2N, MASK_2NE, MASK_2SE },
+	{ MASK_3E, MASK_3N, MASK_3NE, MASK_3SE },
+};
+
+alignas(32) inline constexpr uint64_t DIRECTION_MASK_BACKWARD[3][4] =
+{
+	{ MASK_1W, MASK_1S, MASK_1SW, MASK_1NW },
+	{ MASK_2W, MASK_2S, MASK_2SW, MASK_2NW },
+	{ MASK_3W, MASK_3S, MASK_3SW, MASK_3NW },
+};
+
 #pragma endregion
 
 #pragma region // Mask for filling columns.
@@ -0,0 +1,147 @@
+#pragma once
+#include <stdint.h>
+#include "zobrist.h"		// The stored keys are only valid for the same zobrist values
+#include "VirtualMemory.h"	// For writing the snapshot files
+
+/* TABLE SNAPSHOT HEADER FILE
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+This header defines the file format used to save transposition tables, so
+they can be mapped back into memory by a later run, see VirtualMemory.h.
+
+A snapshot starts with a header page listing its sections, every section
+is the raw memory of a table and starts at a page boundary. The tables are
+mapped as they are, so the version must change with any layout change.
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+*/
+
+/*
+-------------------------------------------------------------------------------------------------------
+Macros for snapshots
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Values that identify a snapshot file. The version must be increased with any change
+// of the tables layout, and the keys value changes if the zobrist values change.
+
+#define SNAPSHOT_MAGIC 0xC4C4AB1E5AB5C0DEULL
+#define SNAPSHOT_VERSION 2u
+#define SNAPSHOT_KEYS (INITIAL_HASH ^ ZOBRIST_SEED)
+
+#define SNAPSHOT_ALIGNMENT 4096ULL // Sections start at page boundaries
+#define SNAPSHOT_MAX_SECTIONS 8u   // Maximum number of tables in a snapshot
+
+// Kinds of tables that can be stored in a snapshot.
+enum SnapshotKind : uint32_t
+{
+    SNAPSHOT_EMPTY = 0,
+    SNAPSHOT_TT = 1,    // TransTable buckets
+    SNAPSHOT_HTT = 2,   // HeuristicTransTable slots
+};
+
+/*
+-------------------------------------------------------------------------------------------------------
+Snapshot structures
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Describes a table inside the snapshot file.
+struct SnapshotSection
+{
+    uint32_t kind = SNAPSHOT_EMPTY; // Kind of table stored
+    uint32_t unit = 0;              // Size of the table units (buckets or slots)
+    uint64_t offset = 0;            // Offset of the table memory from the start of the file
+    uint64_t bytes = 0;             // Size of the table memory
+    uint64_t generation = 0;        // Generation of the live entries of the table
+};
+
+// Header at the start of every snapshot file.
+struct SnapshotHeader
+{
+    uint64_t magic = SNAPSHOT_MAGIC;
+    uint32_t version = SNAPSHOT_VERSION;
+    uint32_t sections = 0;
+    uint64_t keys = SNAPSHOT_KEYS;
+    SnapshotSection section[SNAPSHOT_MAX_SECTIONS];
+};
+
+// A table to be saved, the section offset is computed when writing.
+struct SnapshotTable
+{
+    SnapshotSection section;
+    const void* memory;
+};
+
+/*
+-------------------------------------------------------------------------------------------------------
+Snapshot functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Writes the given tables into a snapshot file, overwriting it if it exists.
+// Tables with no memory are skipped. Returns false if the file could not be written.
+// 
+// It is written under a temporary name and then renamed, so tables mapped from the
+// previous file keep their pages. Windows can not replace a file that is still mapped.
+static inline bool saveSnapshot(const char* filename, const SnapshotTable* tables, unsigned count)
+{
+    if (!filename || count > SNAPSHOT_MAX_SECTIONS)
+        return false;
+
+    SnapshotHeader head = {};
+    uint64_t offset = SNAPSHOT_ALIGNMENT;
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!tables[i].memory || !tables[i].section.bytes)
+            continue;
+
+        SnapshotSection& s = head.section[head.sections++];
+        s = tables[i].section;
+        s.offset = offset;
+        offset += (s.bytes + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+    }
+
+    // The header page and every table followed by the padding up to the next page.
+    static const unsigned char padding[SNAPSHOT_ALIGNMENT] = {};
+    const void* parts[2 + 2 * SNAPSHOT_MAX_SECTIONS] = { &head, padding };
+    size_t sizes[2 + 2 * SNAPSHOT_MAX_SECTIONS] = { sizeof(SnapshotHeader), SNAPSHOT_ALIGNMENT - sizeof(SnapshotHeader) };
+    size_t n_parts = 2;
+
+    for (unsigned i = 0, n = 0; i < count; i++)
+    {
+        if (!tables[i].memory || !tables[i].section.bytes)
+            continue;
+
+        const SnapshotSection& s = head.section[n++];
+
+        parts[n_parts] = tables[i].memory;
+        sizes[n_parts++] = (size_t)s.bytes;
+        parts[n_parts] = padding;
+        sizes[n_parts++] = (size_t)((s.bytes + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT - s.bytes);
+    }
+
+    return VirtualMemory::replace_file(filename, parts, sizes, n_parts);
+}
+
+// Looks for a table of the given kind and unit size inside a mapped snapshot file.
+// Returns nullptr if the file is not a valid snapshot or the table is not in it.
+static inline const SnapshotSection* findSnapshotSection(const void* file, size_t bytes, uint32_t kind, uint32_t unit)
+{
+    if (!file || bytes < SNAPSHOT_ALIGNMENT)
+        return nullptr;
+
+    const SnapshotHeader* head = (const SnapshotHeader*)file;
+    if (head->magic != SNAPSHOT_MAGIC || head->version != SNAPSHOT_VERSION ||
+        head->keys != SNAPSHOT_KEYS || head->sections > SNAPSHOT_MAX_SECTIONS)
+        return nullptr;
+
+    for (unsigned i = 0; i < head->sections; i++)
+    {
+        const SnapshotSection* s = &head->section[i];
+        if (s->kind == kind && s->unit == unit && s->offset % SNAPSHOT_ALIGNMENT == 0 &&
+            s->offset <= bytes && s->bytes <= bytes - s->offset)
+            return s;
+    }
+    return nullptr;
+}
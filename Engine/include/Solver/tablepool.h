@@ -0,0 +1,106 @@
+#pragma once
+#include "tt.h"
+#include "heuristictt.h"
+#include <atomic>
+
+/* TRANSPOSITION TABLE POOL HEADER FILE
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+This header defines a pool of transposition tables that several engines
+can attach to instead of allocating their own, so the memory used does
+not grow with the number of engines and positions searched by one engine
+are already known by the rest.
+
+The tables are lockless, so the engines attached can search at the same
+time. Each engine attaches with an owner, engines of owner 0 share every
+entry, the entries of any other owner are only found by engines of that
+same owner, for results that must stay separate, see TransTable::share().
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+*/
+
+/*
+-------------------------------------------------------------------------------------------------------
+Macros for table pools
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Share of the memory budget, in eighths, given to each transposition table.
+// Used by the pools and by the engines that allocate their own tables.
+
+#define HTT_MEMORY_EIGHTHS      4
+#define TT_MEMORY_EIGHTHS       3
+#define PATH_TT_MEMORY_EIGHTHS  1
+
+/*
+-------------------------------------------------------------------------------------------------------
+Table pool structure
+-------------------------------------------------------------------------------------------------------
+*/
+
+// This structure holds the tables shared by the engines attached to it, see
+// EngineConnect4::attach_tables(). It must outlive every engine attached.
+struct TablePool
+{
+private:
+    TransTable TT;                      // Exact tree table
+    HeuristicTransTable HTT;            // Heuristic tree table
+    TransTable pathTT;                  // Distance solver table
+    std::atomic<unsigned> engines = 0;  // Engines attached
+
+public:
+    // Allocates the tables of the pool, splitting memory_mb megabytes like an engine does.
+    inline TablePool(size_t memory_mb) : TT(0), HTT(0), pathTT(0)
+    {
+        const size_t eighth = (memory_mb << 20) / 8;
+
+        HTT.init(eighth * HTT_MEMORY_EIGHTHS);
+        TT.init(eighth * TT_MEMORY_EIGHTHS);
+        pathTT.init(eighth * PATH_TT_MEMORY_EIGHTHS);
+    }
+
+    // No copies of a pool are allowed, it owns the tables.
+    TablePool(const TablePool&) = delete;
+    // No copies of a pool are allowed, it owns the tables.
+    TablePool& operator=(const TablePool&) = delete;
+
+    // Turns the given tables into views of the pool ones, salted by the owner.
+    inline void attach(TransTable& tt, HeuristicTransTable& htt, TransTable& path_tt, uint64_t owner)
+    {
+        tt.share(TT, owner);
+        htt.share(HTT, owner);
+        path_tt.share(pathTT, owner);
+        engines.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Counts off an engine that no longer uses its views.
+    inline void detach()
+    {
+        engines.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Returns the number of engines attached.
+    inline unsigned attached() const
+    {
+        return engines.load(std::memory_order_relaxed);
+    }
+
+    // Empties the tables, see TransTable::clear(). The views keep the generation they
+    // were attached with, so it returns false and does nothing if any engine is attached.
+    inline bool clear()
+    {
+        if (attached())
+            return false;
+
+        TT.clear();
+        HTT.clear();
+        pathTT.clear();
+        return true;
+    }
+
+    // Returns the memory used by the tables in bytes.
+    inline size_t size() const
+    {
+        return TT.size() + HTT.size() + pathTT.size();
+    }
+};
@@ -2,6 +2,15 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <bit>		// For std::bit_floor() and std::has_single_bit()
+#include <atomic>
+#include "VirtualMemory.h"	// For the table memory, with large pages when available
+#include "snapshot.h"		// For saving the table and mapping it back
+#include "ttstats.h"		// For the table statistics
+#include <xmmintrin.h>	// For _mm_prefetch()
+#ifdef __AVX2__
+#include <immintrin.h>	// For scanning a whole bucket at once (compile with /arch:AVX2)
+#endif
 
 /* TRANSPOSITION TABLE HEADER FILE 
 -------------------------------------------------------------------------------------------------------
@@ -20,16 +29,33 @@ Macros for TTs
 
 #define _EXACT_TT
 
-// Number of entries that will be created by defaul in a transposition table.
+// If defined, the solvers prefetch the table entries of the children of a node before
+// searching the first one, so their cache misses overlap instead of stalling each probe.
+// Comment it out to benchmark the solvers without it.
+
+#define _TT_PREFETCH
+
+// If defined, exactTree keeps the nodes close to the leaves in a small table private to each 
+// thread, see TT_LOCAL_DEPTH. Those nodes are rarely reused by other threads, and sharing their 
+// cache lines only adds traffic between cores. Comment it out to benchmark the solvers without it.
+
+#define _TT_LOCAL
+
+// Remaining depth up to which exactTree nodes use the table of the thread, and its size in
+// bytes. It is meant to fit in the private L2 cache of a core (128K entries).
+
+#define TT_LOCAL_DEPTH 6
+#define TT_LOCAL_SIZE (1024ULL << 10)
+
+// Memory used by default by a transposition table, in bytes.
 // 
-// The solver generates a TT for every moveCount that it analises. That way it avoids 
-// overriding hot boards of different depths. But that comes at the cost of a lor of 
-// memory usage. 
-// The number below seems to be the perfect balance between maintaining hot paths 
-// avaliable on the TT and not making it too big for the program to search for
-// different entries. Modify with caution.
+// A single table is shared by every moveCount, its replacement policy takes care of 
+// keeping the hot boards of the current search, see TransTable::probe(). 
+// The engines size their tables from the memory budget they are given, so this 
+// is only used by the solver functions when no table is provided. Short solves are 
+// faster with a table that stays in cache, long analyses want as much as possible.
 
-#define TT_SIZE 0x4000ULL // 1/4 MB (16384 entries)
+#define TT_DEFAULT_SIZE (4ULL << 20) // 4 MB (256K entries)
 
 // Flags for defining the type of entry depending on the kind of information
 // we have about the Board score.
@@ -47,36 +73,228 @@ Transposition Table and its Entries defintion
 
 // This structure defines an entry of the transposition table, storing the key or board hash
 // and other values the minimax algorith will use to avoid unnecesary computation.
+// 
+// Inside the table entries are packed in a single 64-bit word, see TTBucket. This is the 
+// unpacked copy the table hands out when a board is found.
 struct TTEntry {
     uint64_t key;           // full key
     uint8_t  depth;         // remaining depth stored
-    int8_t   score;         // -1,0,+1 from current side POV
+    int8_t   score;         // -1,0,+1 from current side POV (distance score for distanceTree)
     uint8_t  flag;          // 0=EXACT, 1=LOWER, 2=UPPER
     uint8_t  bestCol;       // If existing stores the best move (if not =255)
-    // pad 4 bytes
+    uint8_t  moveCount;     // Moves played on the stored board
 
-    inline void set(uint64_t _key, uint8_t _depth, int8_t _score, uint8_t _flag, uint8_t _bestCol)
+    // Ply up to which the entry was searched. Every node of the same search shares it,
+    // so entries left by older roots or shallower iterations have a lower horizon.
+    inline unsigned horizon() const
     {
-        score = _score;
-        depth = _depth;
-        flag = _flag;
-        bestCol = _bestCol;
-        key = _key;
+        return (unsigned)moveCount + depth;
     }
 };
 
-// This structure defines our tranposition table, it stores an array of 2^n entries.
-// Each board can acces an entry of the array masking their key (hash).
+// Layout of a packed entry, from the lowest bit:
+// depth (7) | score (8) | flag (2) | bestCol (4) | moveCount (7) | generation (4) | key verification (32)
+// 
+// The bucket is chosen with the lowest bits of the key, so as long as the table has less 
+// than 2^32 buckets the verification bits are not implied by the bucket. The generation 
+// and the verification bits form the tag, and the whole entry can be checked with the tag
+// of the board. Generations go from 1 to TT_GENERATIONS, so an empty slot, a zero word,
+// never matches and entries of older generations are seen as empty, see TransTable::clear().
+
+#define TT_PACK_SCORE_SHIFT     7
+#define TT_PACK_FLAG_SHIFT      15
+#define TT_PACK_COL_SHIFT       17
+#define TT_PACK_MOVES_SHIFT     21
+#define TT_PACK_GEN_SHIFT       28
+#define TT_PACK_KEY_SHIFT       32
+
+#define TT_PACK_NO_COL          0xFu
+#define TT_BUCKET_SLOTS         8
+#define TT_GENERATIONS          15u
+
+// Returns the tag of a key in the given generation, the bits of its packed entries above
+// TT_PACK_GEN_SHIFT. Only the entries of the current generation are found.
+static inline uint64_t packTag(uint64_t key, uint8_t generation)
+{
+    return (key >> TT_PACK_KEY_SHIFT << TT_PACK_KEY_SHIFT) | ((uint64_t)generation << TT_PACK_GEN_SHIFT);
+}
+
+// Packs the entry values in a single word that can be written at once.
+static inline uint64_t packEntry(uint64_t tag, uint8_t depth, int8_t score, uint8_t flag, uint8_t bestCol, uint8_t moveCount)
+{
+    return (uint64_t)(depth & 0x7Fu)
+        | ((uint64_t)(uint8_t)score << TT_PACK_SCORE_SHIFT)
+        | ((uint64_t)(flag & 0x3u) << TT_PACK_FLAG_SHIFT)
+        | ((uint64_t)(bestCol < TT_PACK_NO_COL ? bestCol : TT_PACK_NO_COL) << TT_PACK_COL_SHIFT)
+        | ((uint64_t)(moveCount & 0x7Fu) << TT_PACK_MOVES_SHIFT)
+        | tag;
+}
+
+// Unpacks the entry values into the given TTEntry.
+static inline void unpackEntry(uint64_t packed, uint64_t key, TTEntry& entry)
+{
+    const uint8_t col = (uint8_t)((packed >> TT_PACK_COL_SHIFT) & 0xFu);
+
+    entry.key       = key;
+    entry.depth     = (uint8_t)(packed & 0x7Fu);
+    entry.score     = (int8_t)(uint8_t)(packed >> TT_PACK_SCORE_SHIFT);
+    entry.flag      = (uint8_t)((packed >> TT_PACK_FLAG_SHIFT) & 0x3u);
+    entry.bestCol   = (col == TT_PACK_NO_COL) ? 255 : col;
+    entry.moveCount = (uint8_t)((packed >> TT_PACK_MOVES_SHIFT) & 0x7Fu);
+}
+
+// A bucket fills a cache line with packed entries. Every slot is read and written with a
+// single relaxed 64-bit atomic operation, so the threads that share a table never see
+// half written entries and do not need any lock. A race can only lose one of two stores.
+struct alignas(64) TTBucket
+{
+    std::atomic<uint64_t> slot[TT_BUCKET_SLOTS];
+};
+
+// Checks if a packed word is an entry with the given tag, see packTag().
+static inline bool packedMatches(uint64_t packed, uint64_t tag)
+{
+    return (packed ^ tag) < (1ULL << TT_PACK_GEN_SHIFT);
+}
+
+// Checks if a packed word is an entry of an older generation or an empty slot.
+static inline bool packedStale(uint64_t packed, uint64_t tag)
+{
+    return ((packed ^ tag) >> TT_PACK_GEN_SHIFT) & 0xFu;
+}
+
+// Looks for the tag inside the bucket. If it is found, returns true and copies the
+// packed word and its slot. The word is read at once, so it can not change while checked.
+static inline bool bucketFind(const TTBucket& bucket, uint64_t tag, uint64_t& packed, unsigned& slot)
+{
+#ifdef __AVX2__
+    // Compares the tags of every slot at once. An aligned 256 bit load never
+    // splits a slot, but the matching word is read again in case it changed.
+    const __m256i t = _mm256_set1_epi64x((long long)(tag >> TT_PACK_GEN_SHIFT));
+    const __m256i lo = _mm256_srli_epi64(_mm256_load_si256((const __m256i*)&bucket.slot[0]), TT_PACK_GEN_SHIFT);
+    const __m256i hi = _mm256_srli_epi64(_mm256_load_si256((const __m256i*)&bucket.slot[4]), TT_PACK_GEN_SHIFT);
+
+    unsigned hits = (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(lo, t)))
+        | (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(hi, t))) << 4;
+
+    for (; hits; hits &= hits - 1)
+    {
+        slot = std::countr_zero(hits);
+        packed = bucket.slot[slot].load(std::memory_order_relaxed);
+        if (packedMatches(packed, tag))
+            return true;
+    }
+    return false;
+#else
+    for (slot = 0; slot < TT_BUCKET_SLOTS; slot++)
+    {
+        packed = bucket.slot[slot].load(std::memory_order_relaxed);
+        if (packedMatches(packed, tag))
+            return true;
+    }
+    return false;
+#endif
+}
+
+// Returns the slot where the tag has to be stored and sets found if it is already there, 
+// with its packed word. Otherwise it is the slot with the lowest rank: (moveCount + depth) << 7 | depth.
+// Empty and stale slots go first with rank 0, then the lowest horizon (see TTEntry::horizon()) 
+// and then the lowest depth. Entries of boards with less moves than floor also rank 0.
+static inline unsigned bucketSlot(const TTBucket& bucket, uint64_t tag, uint8_t floor, bool& found, uint64_t& packed)
+{
+    unsigned slot;
+#ifdef __AVX2__
+    if ((found = bucketFind(bucket, tag, packed, slot)))
+        return slot;
+
+    // The ranks take less than 32 bits, the slot index is kept in the lowest 3 bits of
+    // every 64 bit lane and a 32 bit minimum of the low halves finds the victim.
+    const __m256i m7 = _mm256_set1_epi64x(0x7F);
+    const __m256i mg = _mm256_set1_epi64x(0xF);
+    const __m256i g = _mm256_set1_epi64x((long long)((tag >> TT_PACK_GEN_SHIFT) & 0xFu));
+    const __m256i lo = _mm256_load_si256((const __m256i*)&bucket.slot[0]);
+    const __m256i hi = _mm256_load_si256((const __m256i*)&bucket.slot[4]);
+
+    const __m256i f = _mm256_set1_epi64x((long long)floor - 1);
+    const __m256i dlo = _mm256_and_si256(lo, m7);
+    const __m256i dhi = _mm256_and_si256(hi, m7);
+    const __m256i mlo = _mm256_and_si256(_mm256_srli_epi64(lo, TT_PACK_MOVES_SHIFT), m7);
+    const __m256i mhi = _mm256_and_si256(_mm256_srli_epi64(hi, TT_PACK_MOVES_SHIFT), m7);
+    const __m256i hlo = _mm256_add_epi64(dlo, mlo);
+    const __m256i hhi = _mm256_add_epi64(dhi, mhi);
+
+    // Lanes of the current generation at or above the floor keep their rank, the others drop it to 0.
+    const __m256i clo = _mm256_and_si256(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_srli_epi64(lo, TT_PACK_GEN_SHIFT), mg), g), _mm256_cmpgt_epi64(mlo, f));
+    const __m256i chi = _mm256_and_si256(_mm256_cmpeq_epi64(_mm256_and_si256(_mm256_srli_epi64(hi, TT_PACK_GEN_SHIFT), mg), g), _mm256_cmpgt_epi64(mhi, f));
+
+    const __m256i rlo = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi64(_mm256_or_si256(_mm256_slli_epi64(hlo, 7), dlo), 3), clo), _mm256_setr_epi64x(0, 1, 2, 3));
+    const __m256i rhi = _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi64(_mm256_or_si256(_mm256_slli_epi64(hhi, 7), dhi), 3), chi), _mm256_setr_epi64x(4, 5, 6, 7));
+
+    __m256i r = _mm256_min_epu32(rlo, rhi);
+    r = _mm256_min_epu32(r, _mm256_permute4x64_epi64(r, 0x4E));
+    r = _mm256_min_epu32(r, _mm256_shuffle_epi32(r, 0x4E));
+
+    return (unsigned)_mm256_cvtsi256_si32(r) & (TT_BUCKET_SLOTS - 1);
+#else
+    unsigned victimRank = UINT32_MAX;
+    unsigned victim = 0;
+
+    for (slot = 0; slot < TT_BUCKET_SLOTS; slot++)
+    {
+        packed = bucket.slot[slot].load(std::memory_order_relaxed);
+        if (packedMatches(packed, tag))
+        {
+            found = true;
+            return slot;
+        }
+
+        const unsigned depth = (unsigned)(packed & 0x7Fu);
+        const unsigned moves = (unsigned)((packed >> TT_PACK_MOVES_SHIFT) & 0x7Fu);
+        const unsigned rank = (packedStale(packed, tag) || moves < floor) ? 0 : (depth + moves) << 7 | depth;
+
+        const bool lower = rank < victimRank;
+        victim = lower ? slot : victim;
+        victimRank = lower ? rank : victimRank;
+    }
+
+    found = false;
+    return victim;
+#endif
+}
+
+// This structure defines our tranposition table, it stores an array of 2^n buckets.
+// Each board can acces a bucket of the array masking their key (hash).
+// A single table holds the boards of every moveCount, sized by a memory budget.
 struct TransTable 
 {
 private:
-    TTEntry* entries = nullptr;
-    uint32_t mask;
+    TTBucket* buckets = nullptr;
+    uint64_t mask;
+    size_t pageSize = 0;
+    void* mapping = nullptr;    // Snapshot file the buckets are mapped from, see map()
+    size_t mappingBytes = 0;
+    bool readOnly = false;
+    bool shared = false;        // Whether the buckets belong to another table, see share()
+    uint8_t generation = 1;     // Generation of the live entries, see clear()
+    uint8_t floor = 0;          // Entries with less moves are replaced first, see set_floor()
+    uint64_t salt = 0;          // Xored into every key of a shared view, see share()
+    const TransTable* base = nullptr; // Table read below this one, see fork()
+#ifdef _TT_STATS
+    mutable TTCounters counters; // Probes and stores counted, see stats()
+#endif
+
+    // This function sets to zero the entire transposition table and starts the first generation.
+    // Big tables are cleared by several threads, see VirtualMemory::clear().
+    inline void wipe()
+    {
+        VirtualMemory::clear((void*)buckets, size(), pageSize);
+        generation = 1;
+    }
 
 public:
-    inline TransTable(size_t pow2_entries = TT_SIZE)
+    inline TransTable(size_t bytes = TT_DEFAULT_SIZE)
     {
-        init(pow2_entries);
+        init(bytes);
     }
     inline ~TransTable()
     {
@@ -86,77 +304,247 @@ public:
     // Checks wether the entries have been created or not.
     inline bool is_init()
     {
-        if (entries)
+        if (buckets)
             return true;
         return false;
     }
 
-    // This function initialises the transposition table to a given length.
-    // The lenght must be a power of 2 for the mask to work properly.
-    inline void init(size_t pow2_entries = TT_SIZE)
+    // This function initialises the transposition table to fit in the given bytes.
+    // The number of buckets is rounded down to a power of 2 for the mask to work properly.
+    // The memory comes from the system pages, which are already aligned for the buckets.
+    inline void init(size_t bytes = TT_DEFAULT_SIZE)
+    {
+        erase();
+
+        size_t pow2_buckets = bytes / sizeof(TTBucket);
+        if (pow2_buckets < 1)
+            pow2_buckets = 1;
+        pow2_buckets = std::bit_floor(pow2_buckets);
+
+        buckets = (TTBucket*)VirtualMemory::allocate(sizeof(TTBucket) * pow2_buckets, pageSize);
+        mask = buckets ? pow2_buckets - 1 : 0;
+        if (buckets)
+            wipe();
+    }
+
+    // Returns the memory used by the entries in bytes.
+    inline size_t size() const
     {
-        if (entries)
-            free(entries);
+        return buckets ? sizeof(TTBucket) * (mask + 1) : 0;
+    }
 
-        entries = (TTEntry*)calloc(sizeof(TTEntry), pow2_entries);
-        mask = (uint32_t)(pow2_entries - 1);
+    // Returns the size of the pages backing the table, to know if large pages were obtained.
+    inline size_t page_size() const
+    {
+        return buckets ? pageSize : 0;
     }
 
-    // This function sets to zero the entire transposition table.
+    // This function empties the transposition table by starting a new generation, the entries 
+    // of older ones are not found anymore and are the first to be replaced. Only when the
+    // generations run out the memory is swept, once every TT_GENERATIONS calls.
     inline void clear()
     {
-        if (!entries)
+        if (!buckets || readOnly || shared)
             return;
 
-        memset(entries, 0U, sizeof(TTEntry) * (mask + 1));
+        if (generation < TT_GENERATIONS)
+            generation++;
+        else
+            wipe();
+    }
+
+    // Makes the table an overlay of the parent: boards missing here are looked up in the parent,
+    // but every store stays in this table, so the parent is never modified and keeps working
+    // at the same time. A fork starts with everything the parent knows without copying it.
+    // The parent must outlive the fork, nullptr stops reading it. A table can not be its own parent.
+    inline void fork(const TransTable* parent)
+    {
+        base = parent != this ? parent : nullptr;
+    }
+
+    // Sets the move count of the root of the search. Boards with less moves can not be reached
+    // anymore, so their entries are replaced before any other live entry, like stale ones. They
+    // are still found until replaced, and a lower floor makes the ones left live again.
+    // Shared views keep no floor, other engines may still be searching those boards.
+    inline void set_floor(uint8_t moveCount)
+    {
+        floor = shared ? 0 : moveCount;
     }
 
     // This function erases the memory of the transposition table.
+    // A shared view only lets go of the buckets, they belong to the shared table.
     inline void erase()
     {
-        if (!entries)
+        if (!buckets)
+            return;
+
+        if (mapping)
+            VirtualMemory::unmap_file(mapping, mappingBytes);
+        else if (!shared)
+            VirtualMemory::release(buckets, size(), pageSize);
+
+        buckets = nullptr;
+        mapping = nullptr;
+        readOnly = false;
+        shared = false;
+        salt = 0;
+        floor = 0;
+    }
+
+    // Turns this table into a view of the buckets of another one, releasing its own. The
+    // tables are lockless, so views used from different engines can search at the same time.
+    // With owner 0 the view shares every entry, otherwise its keys are salted by the owner
+    // and its entries are only found by views of the same owner, but they still compete for
+    // the same buckets. The shared table must outlive its views and not be cleared meanwhile.
+    inline void share(const TransTable& table, uint64_t owner = 0)
+    {
+        erase();
+        if (!table.buckets)
             return;
 
-        free(entries);
-        entries = nullptr;
+        buckets = table.buckets;
+        mask = table.mask;
+        pageSize = table.pageSize;
+        readOnly = table.readOnly;
+        generation = table.generation;
+        shared = true;
+        salt = owner * 0x9E3779B97F4A7C15ULL;
     }
 
-    // Checks to  see if the board position is stored in the table.
-    // If so, returns the pointer, otherwise returns nullptr.
-    inline TTEntry* storedBoard(uint64_t key) const
+    // Returns the table memory as a snapshot section, to be saved with saveSnapshot().
+    inline SnapshotTable snapshot() const
     {
-        TTEntry* e0 = &entries[key & mask];
-        if (e0->key == key) return e0;
-        TTEntry* e1 = &entries[(key & mask) ^ 1];
-        if (e1->key == key) return e1;
+        return { { SNAPSHOT_TT, sizeof(TTBucket), 0, size(), generation }, buckets };
+    }
+
+    // Maps the table stored in a snapshot file in place of the current one, see snapshot.h.
+    // If copy_on_write the table works as usual and the file is never modified, otherwise
+    // the table is read-only and stores are ignored. Returns false if the table is not found.
+    inline bool map(const char* filename, bool copy_on_write = true)
+    {
+        size_t bytes = 0;
+        void* file = VirtualMemory::map_file(filename, bytes, copy_on_write);
+        const SnapshotSection* section = findSnapshotSection(file, bytes, SNAPSHOT_TT, sizeof(TTBucket));
 
-        return nullptr;
+        // The number of buckets must be a power of 2 for the mask to work properly.
+        if (!section || section->bytes % sizeof(TTBucket) || !std::has_single_bit(section->bytes / sizeof(TTBucket)) ||
+            !section->generation || section->generation > TT_GENERATIONS)
+        {
+            VirtualMemory::unmap_file(file, bytes);
+            return false;
+        }
+
+        erase();
+        buckets = (TTBucket*)((unsigned char*)file + section->offset);
+        mask = section->bytes / sizeof(TTBucket) - 1;
+        pageSize = VirtualMemory::system_page_size();
+        mapping = file;
+        mappingBytes = bytes;
+        readOnly = !copy_on_write;
+        generation = (uint8_t)section->generation;
+        return true;
     }
 
-    // This function returns the pointer to an entry of the table given a certain key.
-    // To choose the position it choses between the masked key or its tggled one,
-    // allowing for better collision management. It is called 2-slot bucket.
-    inline TTEntry* probe(uint64_t key) const
+    // Checks to see if the board position is stored in the table.
+    // If so, it copies the unpacked entry and returns true, otherwise returns false.
+    inline bool storedBoard(uint64_t key, TTEntry& entry) const
     {
-        TTEntry* e0 = &entries[key & mask];
-        if (e0->key == key) return e0;
-        TTEntry* e1 = &entries[(key & mask) ^ 1];
-        if (e1->key == key) return e1;
+        uint64_t packed;
+        unsigned slot;
+
+#ifdef _TT_STATS
+        counters.probe();
+#endif
+        const uint64_t salted = key ^ salt;
+        if (!bucketFind(buckets[salted & mask], packTag(salted, generation), packed, slot))
+            return base && base->storedBoard(key, entry);
 
-        // choose a victim by lower depth (or empty)
-        if (e0->depth <= e1->depth) return e0;
-        return e1;
+        unpackEntry(packed, key, entry);
+#ifdef _TT_STATS
+        counters.count(entry.moveCount, TTCounters::HITS);
+#endif
+        return true;
+    }
+
+    // Asks the processor to bring the bucket of the key into the cache, so a later probe
+    // does not wait for memory. It is only a hint, the table is not read nor modified.
+    inline void prefetch(uint64_t key) const
+    {
+        _mm_prefetch((const char*)&buckets[(key ^ salt) & mask], _MM_HINT_T0);
+        if (base)
+            base->prefetch(key);
     }
 
     // This function receives a TT entry and stores it inside te transposition table.
-    inline int8_t store(uint64_t key, uint8_t depth, int8_t score, uint8_t flag, uint8_t bestCol) const
+    // 
+    // If the board is already in the bucket it is only replaced by deeper searches. 
+    // Otherwise it replaces the victim of the bucket, see bucketSlot().
+    inline int8_t store(uint64_t key, uint8_t depth, int8_t score, uint8_t flag, uint8_t bestCol, uint8_t moveCount) const
     {
-        TTEntry* e = probe(key);
-        
-        // If keys are different or you are deeper
-        if (depth >= e->depth || e->key != key)
-            e->set(key, depth, score, flag, bestCol);
+        if (readOnly)
+            return score;
+
+        key ^= salt;
+        TTBucket& bucket = buckets[key & mask];
+        const uint64_t tag = packTag(key, generation);
+
+        bool found;
+        uint64_t packed;
+        const unsigned slot = bucketSlot(bucket, tag, floor, found, packed);
+
+#ifdef _TT_STATS
+        if (!found)
+        {
+            counters.count(moveCount, TTCounters::INSERTS);
+            if (!packedStale(bucket.slot[slot].load(std::memory_order_relaxed), tag))
+                counters.count(moveCount, TTCounters::COLLISIONS);
+        }
+        else
+            counters.count(moveCount, depth >= (packed & 0x7Fu) ? TTCounters::UPDATES : TTCounters::REFUSED);
+#endif
+
+        // If it is a different board or you are deeper
+        if (!found || depth >= (packed & 0x7Fu))
+            bucket.slot[slot].store(packEntry(tag, depth, score, flag, bestCol, moveCount), std::memory_order_relaxed);
 
         return score;
     }
-};
\ No newline at end of file
+
+    // Returns the statistics of the table. The entries are counted by scanning the whole
+    // table, the rest only if _TT_STATS is defined, see ttstats.h. 
+    inline TTStats stats() const
+    {
+        TTStats stats;
+#ifdef _TT_STATS
+        counters.copy(stats);
+#endif
+        if (!buckets)
+            return stats;
+
+        stats.capacity = (mask + 1) * TT_BUCKET_SLOTS;
+
+        // The tag of key 0 leaves only the generation to compare.
+        const uint64_t tag = packTag(0, generation);
+        for (uint64_t i = 0; i <= mask; i++)
+            for (unsigned j = 0; j < TT_BUCKET_SLOTS; j++)
+            {
+                const uint64_t packed = buckets[i].slot[j].load(std::memory_order_relaxed);
+                if (packedStale(packed, tag))
+                    continue;
+
+                const unsigned moveCount = (unsigned)((packed >> TT_PACK_MOVES_SHIFT) & 0x7Fu);
+                stats.moves[moveCount < TT_STATS_MOVES ? moveCount : TT_STATS_MOVES - 1].entries++;
+                stats.entries++;
+            }
+
+        return stats;
+    }
+
+    // Sets the counters of the table statistics back to zero, see stats().
+    inline void reset_stats() const
+    {
+#ifdef _TT_STATS
+        counters.reset();
+#endif
+    }
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+/* TRANSPOSITION TABLE STATISTICS HEADER FILE
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+This header defines the statistics both transposition tables can report,
+to size them and tune their replacement policies with real data.
+
+How full the table is, per move count, is always computed by scanning the
+table on request. The counters of probes and stores are only compiled when
+_TT_STATS is defined, since every search thread writes the same counters.
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+*/
+
+/*
+-------------------------------------------------------------------------------------------------------
+Macros for table statistics
+-------------------------------------------------------------------------------------------------------
+*/
+
+// If defined, the tables count their probes and stores by move count, see TTCounters.
+// The counters are shared atomics, so they slow down the search and distort timings.
+// Uncomment it to collect them.
+
+// #define _TT_STATS
+
+// Move counts tracked by the statistics, from the empty board to a full 8x8 board.
+#define TT_STATS_MOVES 65u
+
+/*
+-------------------------------------------------------------------------------------------------------
+Statistics structures
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Statistics of the boards of a single move count.
+//
+// Searches store every board they do not find, so inserts are close to the misses
+// and hits / (hits + inserts) is the hit rate of the move count.
+struct TTMoveStats
+{
+    uint64_t entries = 0;       // Live entries in the table
+    uint64_t hits = 0;          // Probes that found the board
+    uint64_t inserts = 0;       // Stores of boards that were not in the table
+    uint64_t collisions = 0;    // Inserts that evicted a live entry of another board
+    uint64_t updates = 0;       // Stores that replaced the entry of the same board
+    uint64_t refused = 0;       // Stores ignored because the stored entry was better
+};
+
+// Statistics of a whole table, returned by the stats() function of the tables.
+// If counting is false the counters were compiled out and only the entries are filled.
+struct TTStats
+{
+    bool counting = false;      // Whether the counters are compiled, see _TT_STATS
+    uint64_t capacity = 0;      // Entries that fit in the table
+    uint64_t entries = 0;       // Live entries in the table
+    uint64_t probes = 0;        // Probes done, found or not
+    uint64_t hits = 0;          // Probes that found the board
+    TTMoveStats moves[TT_STATS_MOVES];
+
+    // Fraction of the table holding live entries.
+    inline double fill() const
+    {
+        return capacity ? (double)entries / (double)capacity : 0.0;
+    }
+
+    // Fraction of the probes that found the board.
+    inline double hit_rate() const
+    {
+        return probes ? (double)hits / (double)probes : 0.0;
+    }
+};
+
+// Counters kept by a table while _TT_STATS is defined. They are written with relaxed
+// atomic additions from every thread, so a snapshot taken during a search is approximate.
+struct TTCounters
+{
+    enum Counter : unsigned { HITS, INSERTS, COLLISIONS, UPDATES, REFUSED, COUNTERS };
+
+    std::atomic<uint64_t> probes{ 0 };
+    std::atomic<uint64_t> counter[TT_STATS_MOVES][COUNTERS] = {};
+
+    // Adds one to the probes counter.
+    inline void probe()
+    {
+        probes.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Adds one to a counter of the given move count.
+    inline void count(uint8_t moveCount, Counter c)
+    {
+        counter[moveCount < TT_STATS_MOVES ? moveCount : TT_STATS_MOVES - 1][c].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Sets every counter back to zero.
+    inline void reset()
+    {
+        probes.store(0, std::memory_order_relaxed);
+        for (auto& move : counter)
+            for (auto& c : move)
+                c.store(0, std::memory_order_relaxed);
+    }
+
+    // Copies the counters into the statistics.
+    inline void copy(TTStats& stats) const
+    {
+        stats.counting = true;
+        stats.probes = probes.load(std::memory_order_relaxed);
+        stats.hits = 0;
+
+        for (unsigned i = 0; i < TT_STATS_MOVES; i++)
+        {
+            TTMoveStats& m = stats.moves[i];
+            m.hits = counter[i][HITS].load(std::memory_order_relaxed);
+            m.inserts = counter[i][INSERTS].load(std::memory_order_relaxed);
+            m.collisions = counter[i][COLLISIONS].load(std::memory_order_relaxed);
+            m.updates = counter[i][UPDATES].load(std::memory_order_relaxed);
+            m.refused = counter[i][REFUSED].load(std::memory_order_relaxed);
+            stats.hits += m.hits;
+        }
+    }
+};
@@ -4,9 +4,10 @@
 /* ZOBRIST VALUES GENERATION HEADER FILE
 -------------------------------------------------------------------------------------------------------
 -------------------------------------------------------------------------------------------------------
-This header stores the functions needed to initialize the zobrist values 
-in the program, the variable where these will be hold and a function to 
-compute the hash of a given board position.
+This header generates the zobrist values at compile time, so they are stored 
+as read only data and need no initialization, and it holds a function to 
+compute the hash of a given board position. Tables can be generated for any
+seed, but the boards always use ZOBRIST_SEED.
 -------------------------------------------------------------------------------------------------------
 -------------------------------------------------------------------------------------------------------
 */
@@ -22,7 +23,7 @@ Macros for Zobrist generation
 #define INITIAL_HASH 0x89B84566FD5845A4ULL
 
 // This seed is a random number used to generate the zobrist values.
-// It can be modified with no problem.
+// It can be modified with no problem, every board hash is built from it.
 #define ZOBRIST_SEED 0x9E3779B97F4A7C15ULL
 
 /*
@@ -31,30 +32,76 @@ Generation of Zobrist Values for each color and position
 -------------------------------------------------------------------------------------------------------
 */
 
-// This variable stores all the zobrist values upon initializing.
-extern uint64_t Z_PIECE[2][64];
+// This is Sebastiano Vigna's mixer.
+// 
+// A proven and tested mixer funtion to
+// generate semi random 64bit integers.
+constexpr uint64_t _splitmix64(uint64_t& x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Zobrist values for each piece and spot, generated at compile time
+// by iterating the seed through the mixer.
+// 
+// byte holds the combined value of every possible byte of a bitboard, since a
+// byte is a column it is the xor of the values of the pieces in that column.
+// This allows hashing a full board with 16 lookups instead of 64 bit tests.
+template<uint64_t SEED>
+struct _ZobristTable
+{
+    uint64_t piece[2][64];
+    uint64_t byte[2][8][256];
+
+    constexpr _ZobristTable() : piece{}, byte{}
+    {
+        uint64_t seed = SEED;
+
+        for (int side = 0; side < 2; ++side)
+            for (int sq = 0; sq < 64; ++sq)
+                piece[side][sq] = _splitmix64(seed);
 
-// Initializes the Zobrist values with the seed provided using a simple mixer algorithm.
-extern void init_zobrist(uint64_t seed = ZOBRIST_SEED);
+        for (int side = 0; side < 2; ++side)
+            for (int column = 0; column < 8; ++column)
+                for (int value = 1; value < 256; ++value)
+                {
+                    int row = 0;
+                    while (!((value >> row) & 1))
+                        row++;
 
-// Computes the board hash.
-// It is quite an expensive function so it is only used for board validity checks.
+                    // Same as the byte without its lowest piece plus that piece
+                    byte[side][column][value] = byte[side][column][value & (value - 1)] ^ piece[side][column * 8 + row];
+                }
+    }
+};
+
+// Zobrist values for any given seed. Only the tables are provided for other seeds,
+// the boards always hash with ZOBRIST_SEED since playMove() and undoMove() update
+// the hash with Z_PIECE, a hash built from another seed would not follow the pieces.
+template<uint64_t SEED>
+inline constexpr _ZobristTable<SEED> ZOBRIST = {};
+
+// Zobrist values used by the boards, generated with the default seed.
+inline constexpr const uint64_t (&Z_PIECE)[2][64] = ZOBRIST<ZOBRIST_SEED>.piece;
+inline constexpr const uint64_t (&Z_BYTE)[2][8][256] = ZOBRIST<ZOBRIST_SEED>.byte;
+
+// Computes the board hash with the default seed, the same one playMove() keeps up to date.
+// It looks up every byte of both bitboards, it is only used to build and check boards,
+// while playing moves the hash is updated incrementally.
 static inline uint64_t boardHash(const uint64_t playerBitboards[2])
 {
     uint64_t hash = INITIAL_HASH;
     const uint64_t p0 = playerBitboards[0];
     const uint64_t p1 = playerBitboards[1];
-    uint64_t bit = 1ULL;
 
-    for (uint8_t i = 0; i < 64; i++)
+    for (uint8_t column = 0; column < 8; column++)
     {
-        if (p0 & bit)
-            hash ^= Z_PIECE[0][i];
-
-        if (p1 & bit)
-            hash ^= Z_PIECE[1][i];
-
-        bit <<= 1u;
+        hash ^= Z_BYTE[0][column][(p0 >> (8 * column)) & 0xFF];
+        hash ^= Z_BYTE[1][column][(p1 >> (8 * column)) & 0xFF];
     }
     return hash;
 }
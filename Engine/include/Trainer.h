@@ -28,6 +28,9 @@ enum Training_Weights
 	ALL				// All the weights are trained
 };
 
+// Pool of transposition tables the tournament engines share, see tablepool.h.
+struct TablePool;
+
 // Contains the set of static functions used for training NeuralNetwors.
 // Most functions use console prints so the class is meant only for console applications.
 class Trainer
@@ -67,7 +70,8 @@ public:
 public:
 	// Game between two different engines using the specified schedulers, given a certain time per move 
 	// and an initial board. It returns 0 if it is a draw, 1 if nn_1 wins and 2 if nn_2 wins.
-	static unsigned char NNvsNN(float sec_per_move, bool see_time_left, Board initial_board, NeuralNetwork* nn_1, NeuralNetwork* nn_2, bool print_boards = false, bool clear_console = true);
+	// If a pool is given the engines use its tables, with the given owners, see attach_tables().
+	static unsigned char NNvsNN(float sec_per_move, bool see_time_left, Board initial_board, NeuralNetwork* nn_1, NeuralNetwork* nn_2, bool print_boards = false, bool clear_console = true, TablePool* pool = nullptr, unsigned owner_1 = 0, unsigned owner_2 = 0);
 
 	// Main function of the class, it takes the last session champions stored in last_session storage,
 	// multiplies them to fit the training size, adding radom noise to the weights. Performs the 
@@ -211,6 +211,9 @@ public:
     // position in the array, if timeout is reached returns -1.
     static int waitForThreads(const Thread* const* threads, unsigned int n_threads, unsigned long timeout_ms = 0xFFFFFFFFUL);
 
+    // Returns the number of logical processors of the system.
+    static unsigned processor_count();
+
 private:
     static short wakeUpGen[256];  // Simple array to store variables for wake-up calls
 public:
@@ -0,0 +1,69 @@
+#pragma once
+
+/* VIRTUAL MEMORY CLASS HEADER FILE
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+This class is a small multiplatform wrapper to allocate big blocks of memory
+directly from the operating system, used by the transposition tables. It uses
+VirtualAlloc for Windows and mmap for other operating systems.
+
+Big tables are probed at random, so most of their cost are TLB misses. To reduce
+them it first tries to obtain large pages (MEM_LARGE_PAGES, MAP_HUGETLB), then
+transparent huge pages where available, and falls back to normal pages. The
+page size obtained is reported back, since it is needed to release the memory.
+
+The memory is zeroed by the operating system, but pages are only mapped when
+first touched. clear() splits the work across threads, so the first touch of
+a big table is done in parallel and does not stall a single thread.
+
+It can also map whole files into memory, so saved tables can be loaded lazily
+by the operating system page by page instead of being read upfront, and
+replace files without disturbing the mappings of their previous contents.
+-------------------------------------------------------------------------------------------------------
+-------------------------------------------------------------------------------------------------------
+*/
+
+#include <stddef.h>
+
+#define VM_CLEAR_MIN_CHUNK (8ULL << 20) // Minimum bytes cleared by each thread in VirtualMemory::clear()
+#define VM_CLEAR_MAX_THREADS 64u        // Maximum threads used by VirtualMemory::clear()
+
+// Definition of the class, everything in this header is contained inside the class VirtualMemory.
+
+// It only contains static functions, the caller owns the memory and must keep
+// the bytes and page size used to allocate it to be able to release it.
+class VirtualMemory {
+public:
+
+    // Allocates at least the given bytes of zeroed memory aligned to its page size.
+    // It tries large pages first, the size of the pages obtained is stored in page_size.
+    // Returns nullptr if the memory could not be allocated.
+    static void* allocate(size_t bytes, size_t& page_size);
+
+    // Releases the memory returned by allocate() with the same bytes and page size.
+    static void release(void* memory, size_t bytes, size_t page_size);
+
+    // Sets to zero the given bytes of memory, splitting the work across threads.
+    // Each thread clears whole pages, so it is also the first to touch them.
+    static void clear(void* memory, size_t bytes, size_t page_size);
+
+    // Maps a whole file into memory and stores its size in bytes. If copy_on_write the memory
+    // can be written without modifying the file, otherwise it is read-only.
+    // Returns nullptr if the file could not be mapped.
+    static void* map_file(const char* filename, size_t& bytes, bool copy_on_write);
+
+    // Unmaps the memory returned by map_file() with the same bytes.
+    static void unmap_file(void* memory, size_t bytes);
+
+    // Writes the given parts one after the other into the file, overwriting it if it exists.
+    // It is written under a temporary name and then renamed, so memory mapped from the
+    // previous file keeps its pages. Returns false if the file could not be written.
+    static bool replace_file(const char* filename, const void* const* parts, const size_t* sizes, size_t n_parts);
+
+    // Returns the large page size supported by the system, 0 if not supported.
+    static size_t large_page_size();
+
+    // Returns the normal page size of the system.
+    static size_t system_page_size();
+
+};
@@ -1,6 +1,8 @@
 #include "heuristicSolver.h"
 #include "Engine_NN.h"
 #include "Engine.h"
+#include "book.h"
+#include "tablepool.h"
 #include "Thread.h"
 #include "Timer.h"
 
@@ -170,6 +172,10 @@ struct DATA
 {
 	HeuristicData H_DATA = {};						// Constant variables for the heuristic tree
 	TransTable* path_TT = nullptr;					// Transposition tables for the pathfinder
+	OpeningBook book;								// Opening book mapped by load_book()
+	EndgameDatabase endgame;						// Endgame database mapped by load_endgame()
+	TablePool* pool = nullptr;						// Pool the tables are views of, see attach_tables()
+	size_t memory_mb = ENGINE_DEFAULT_MEMORY_MB;	// Memory budget of the tables when not pooled
 
 	NeuralNetwork* scheduler = nullptr;
 	unsigned char HEURISTIC_DEPTH = START_DEPTH_H;	// Current depth to analize
@@ -193,6 +199,7 @@ struct DATA
 	bool finding_solution = false;					// Communicator bool to announce board is being solved
 	bool solution_found = false;					// Communicator bool to announce solved board
 	bool updatedBoard = false;						// Communicator bool to announce an new board
+	bool book_hit = false;							// Communicator bool to announce the board is in the book
 
 	unsigned long long cpu_affinity = 0ULL;			// CPU flag the threads will be set to when running.
 };
@@ -228,49 +235,59 @@ inline Connect4 EngineConnect4::decodeBoard(const Board& bitBoard)
 
 inline Board* EngineConnect4::translateBoard(const Connect4& position)
 {
-	init_zobrist();
-
 	Board* board = new Board();
 
-	for(unsigned char r = 0; r<8; r++)
-		for (unsigned char c = 0; c < 8; c++)
-		{
-			unsigned char player = position.board[r][c];
+	if (!cellsToBoard(&position.board[0][0], position.player == 1 ? 0 : 1, *board))
+	{
+		delete board;
+		return nullptr;
+	}
+	return board;
+}
 
-			if (player == 0)
-				continue;
+// It takes an array of Connect4 structs and writes the equivalent bitBoards into the 
+// given array, no memory is allocated. If valid is provided it stores whether each 
+// position was valid, invalid positions leave their board untouched. 
+// Returns the amount of valid positions.
+
+size_t EngineConnect4::translateBoards(const Connect4* positions, size_t count, Board* boards, bool* valid)
+{
+	size_t n_valid = 0;
 
-			else if (player == 1)
-				board->playerBitboard[0] |= bit_at(c, r);
+	for (size_t i = 0; i < count; i++)
+	{
+		const bool ok = cellsToBoard(&positions[i].board[0][0], positions[i].player == 1 ? 0 : 1, boards[i]);
 
-			else if (player == 2)
-				board->playerBitboard[1] |= bit_at(c, r);
+		if (valid)
+			valid[i] = ok;
+		n_valid += ok;
+	}
+	return n_valid;
+}
 
-			else
-			{
-				delete board;
-				return nullptr;
-			}
-			board->moveCount++;
-			board->heights[c]++;
-		}
+// It takes an array of move strings and writes the resulting bitBoards into the given
+// array, no memory is allocated. Every character is a column from '1' to '8'. If valid 
+// is provided it stores whether each string was valid. Returns the amount of valid strings.
 
-	board->hash = boardHash(board->playerBitboard);
-	
-	board->sideToPlay = position.player == 1 ? 0 : 1;
+size_t EngineConnect4::translateMoves(const char* const* moves, size_t count, Board* boards, bool* valid)
+{
+	size_t n_valid = 0;
 
-	if (invalidBoard(*board))
+	for (size_t i = 0; i < count; i++)
 	{
-		delete board;
-		return nullptr;
+		const bool ok = movesToBoard(moves[i], boards[i]);
+
+		if (valid)
+			valid[i] = ok;
+		n_valid += ok;
 	}
-	return board;
+	return n_valid;
 }
 
-// Takes a transposition table entry and returns the corresponding
-// position evaluation. If the entry data is not exact returns invalid.
+// Takes a transposition table entry and returns the corresponding position evaluation,
+// with the column seen from the given board. If the entry data is not exact returns invalid.
 
-static inline PositionEval obtainPosEvalFromEntry(HTTEntry* e)
+static inline PositionEval obtainPosEvalFromEntry(const Board& board, const HTTEntry* e)
 {
 	if (!e) return PositionEval();
 
@@ -288,7 +305,7 @@ static inline PositionEval obtainPosEvalFromEntry(HTTEntry* e)
 		else if (e->eval < 0.f)
 			flag = PositionEval::EvalFlag::OTHER_PLAYER_BETTER;
 
-		return { e->eval,e->order[0], unsigned char(e->heuDepth + e->bitDepth), flag };
+		return { e->eval, keyColumn(board, e->order[0]), unsigned char(e->heuDepth + e->bitDepth), flag };
 
 	case ENTRY_FLAG_LOWER:
 	case ENTRY_FLAG_UPPER:
@@ -305,37 +322,127 @@ Static main loop worker functions
 -------------------------------------------------------------------------------------------------------
 */
 
+// Looks for the entry of the board in the HTT, copies it into entry and returns wether it was found.
+// If not found the entry is cleared, so it can be read as an empty evaluation.
+
+static inline bool read_entry(const HeuristicTransTable* HTT, const Board& board, HTTEntry& entry)
+{
+	if (HTT->storedBoard(boardKey(board), entry))
+		return true;
+
+	entry = {};
+	return false;
+}
+
 // If we find moves that are loosing in the current board we want to make sure this moves are not 
 // listed first on its entry.Since the exactTree overrides the HTT this information will go through, 
 // but the delay might make the information not arrive on time, this function prevents that.
-static inline void check_for_loosing_moves(Board board, TransTable* TT, HTTEntry* e)
+// The given copy of the entry is reordered and written back to the HTT. If another thread
+// stores the board meanwhile, its entry is the one that gets reordered.
+static inline void check_for_loosing_moves(Board board, TransTable* TT, HeuristicTransTable* HTT, HTTEntry& e)
 {
-	if (e->eval != -1.f && e->eval != 1.f)
+	const uint64_t moves = legalMoves(board);
+	const uint64_t state = moveState(board);
+	bool reordered;
+
+	do
 	{
-		e->lock();
-		for (unsigned column = 0; column < 8; column++)
+		if (e.eval == -1.f || e.eval == 1.f)
+			return;
+
+		reordered = false;
+
+		for (unsigned char column = 0; column < 8; column++)
 		{
-			if (!canPlay(board, column))
+			if (!columnMove(moves, column))
 				continue;
 
 			playMove(board, column);
-			TTEntry* sons_entry = TT[board.moveCount].storedBoard(board.hash);
-			undoMove(board, column);
+			TTEntry sons_entry;
+			const bool sons_stored = TT->storedBoard(boardKey(board), sons_entry);
+			undoMove(board, column, state);
 
-			if (sons_entry && sons_entry->score == CURRENT_PLAYER_WIN)
+			// The entry order is stored in the key orientation of the board.
+			const unsigned char keyCol = keyColumn(board, column);
+
+			if (sons_stored && sons_entry.score == CURRENT_PLAYER_WIN)
 				for (unsigned idx = 0; idx < 7; idx++)
 				{
-					if (!canPlay(board, e->order[idx + 1]))
+					if (!columnMove(moves, keyColumn(board, e.order[idx + 1])))
 						break;
 
-					if (e->order[idx] == column)
+					if (e.order[idx] == keyCol)
 					{
-						e->order[idx] = e->order[idx + 1];
-						e->order[idx + 1] = column;
+						e.order[idx] = e.order[idx + 1];
+						e.order[idx + 1] = keyCol;
+						reordered = true;
 					}
 				}
 		}
-		e->unlock();
+	} while (reordered && !HTT->set(e));
+}
+
+// Copies the evaluation of a board found in the opening book into the HTT, unless the table 
+// already knows as much. Returns whether the board is in the book.
+static inline bool seed_book_entry(const OpeningBook& book, HeuristicTransTable* HTT, const Board& board)
+{
+	BookEntry b;
+	if (!book.find(boardKey(board), b))
+		return false;
+
+	HTTEntry e;
+	bool stored = read_entry(HTT, board, e);
+	if (!stored)
+		memcpy(e.order, MOVE_ORDER<Board::WIDTH>.center, sizeof(e.order));
+
+	// If a worker stores the board meanwhile, the book is copied over its entry.
+	do
+	{
+		if (stored && e.flag == ENTRY_FLAG_EXACT && e.heuDepth >= b.heuDepth)
+			return true;
+
+		for (unsigned char c = 0; c < 8; c++)
+			if (e.order[c] == b.column)
+				e.order[c] = e.order[0];
+
+		e.order[0] = b.column;
+		e.key = b.key;
+		e.eval = b.eval;
+		e.heuDepth = b.heuDepth;
+		e.bitDepth = b.bitDepth;
+		e.flag = ENTRY_FLAG_EXACT;
+		e.moveCount = b.moveCount;
+		stored = true;
+	} while (!HTT->set(e));
+
+	return true;
+}
+
+// Looks for the current board and its children in the opening book before the workers start.
+// Seeding the children too lets the first iteration past the book depth end at once, since
+// every child is already known to that depth. The book only holds games started by the first player.
+static inline void check_opening_book(DATA* data)
+{
+	Board board = data->currentBoard;
+	data->book_hit = false;
+
+	if (!data->book.is_open() || board.sideToPlay != (board.moveCount & 1) || board.moveCount > data->book.plies())
+		return;
+
+	data->book_hit = seed_book_entry(data->book, data->H_DATA.HTT, board);
+	if (!data->book_hit)
+		return;
+
+	const uint64_t moves = legalMoves(board);
+	const uint64_t state = moveState(board);
+	for (unsigned char column = 0; column < Board::WIDTH; column++)
+	{
+		if (!columnMove(moves, column))
+			continue;
+
+		playMove(board, column);
+		seed_book_entry(data->book, data->H_DATA.HTT, board);
+		undoMove(board, column, state);
 	}
 }
 
@@ -347,17 +454,22 @@ static inline void main_loop_worker_heuristicSolver(Thread* self_thread, DATA* d
 	HeuristicData H_DATA = data->H_DATA;
 	H_DATA.STOP = STOP;
 
-	HTTEntry* stored_data = H_DATA.HTT[board.moveCount].storedBoard(board.hash);
+	HTTEntry stored_data;
+	bool stored = read_entry(H_DATA.HTT, board, stored_data);
 
 	// If there is not exact data about your board, you need to be able to overwrite it.
-	if (stored_data && stored_data->flag != ENTRY_FLAG_EXACT && stored_data->heuDepth >= data->HEURISTIC_DEPTH)
-		stored_data->heuDepth = 0;
+	while (stored && stored_data.flag != ENTRY_FLAG_EXACT && stored_data.heuDepth >= data->HEURISTIC_DEPTH)
+	{
+		stored_data.heuDepth = 0;
+		if (H_DATA.HTT->set(stored_data))
+			break;
+	}
 
 	// Loops generating heuristic-trees.
 	for (;
 		// It will run until the maximum depth or until it finds a winning sequence for either player.
 		data->HEURISTIC_DEPTH + H_DATA.EXACT_TAIL + board.moveCount <= 64 &&
-		(!stored_data || (stored_data->eval != 1.f && stored_data->eval != -1.f));
+		(!stored || (stored_data.eval != 1.f && stored_data.eval != -1.f));
 		// After every run it increases the depth one step further.
 		data->HEURISTIC_DEPTH++
 		)
@@ -373,10 +485,11 @@ static inline void main_loop_worker_heuristicSolver(Thread* self_thread, DATA* d
 			goto end;
 
 		// We check what data of the actual position we have on storage.
-		stored_data = H_DATA.HTT[board.moveCount].storedBoard(board.hash);
+		stored = read_entry(H_DATA.HTT, board, stored_data);
 
 		// Make sure loosing moves are not first
-		check_for_loosing_moves(board, data->H_DATA.TT, stored_data);
+		if (stored)
+			check_for_loosing_moves(board, data->H_DATA.TT, H_DATA.HTT, stored_data);
 
 	} --data->HEURISTIC_DEPTH; // To keep depth consistent, oops!
 
@@ -384,7 +497,7 @@ static inline void main_loop_worker_heuristicSolver(Thread* self_thread, DATA* d
 		goto end;
 
 	// If a solution was found in the current position the best path will be solved.
-	if (stored_data->eval == 1.f || stored_data->eval == -1.f)
+	if (stored_data.eval == 1.f || stored_data.eval == -1.f)
 	{
 		data->finding_solution = true;
 		*kill_exact = true;
@@ -392,17 +505,23 @@ static inline void main_loop_worker_heuristicSolver(Thread* self_thread, DATA* d
 		// Sets the name to its own thread to the current state for reference.
 		self_thread->set_name(L"Worker HEURISTIC: Pathfinding H%llu", board.hash);
 
-		char* solution = findBestPath(board, (SolveResult)stored_data->eval, data->path_TT, STOP);
+		char* solution = findBestPath(board, (SolveResult)stored_data.eval, data->path_TT, STOP);
 		if (*STOP)
 			goto end;
 
-		stored_data->heuDepth = 0;
-		stored_data->bitDepth = solution[1];
-		for (unsigned char c = 0; c < 8; c++)
-			if (stored_data->order[c] == solution[0])
-				stored_data->order[c] = stored_data->order[0];
+		// The solution column is translated to the key orientation of the entry.
+		const unsigned char column = keyColumn(board, solution[0]);
 
-		stored_data->order[0] = solution[0];
+		do
+		{
+			stored_data.heuDepth = 0;
+			stored_data.bitDepth = solution[1];
+			for (unsigned char c = 0; c < 8; c++)
+				if (stored_data.order[c] == column)
+					stored_data.order[c] = stored_data.order[0];
+
+			stored_data.order[0] = column;
+		} while (!H_DATA.HTT->set(stored_data));
 		free(solution);
 
 		data->solution_found = true;
@@ -411,7 +530,7 @@ static inline void main_loop_worker_heuristicSolver(Thread* self_thread, DATA* d
 	}
 
 	// If the final move was reached with no winner the position is solved, is a draw.
-	if (stored_data->heuDepth + stored_data->bitDepth + board.moveCount == 64)
+	if (stored_data.heuDepth + stored_data.bitDepth + board.moveCount == 64)
 	{
 		*kill_exact = true;
 		data->solution_found = true;
@@ -431,12 +550,13 @@ static inline void main_loop_worker_exactSolver(Thread* self_thread, DATA* data,
 {
 	Board board = data->currentBoard;
 	
-	TTEntry* stored_data = data->H_DATA.TT[board.moveCount].storedBoard(board.hash);
+	TTEntry stored_data = {};
+	bool stored = data->H_DATA.TT->storedBoard(boardKey(board), stored_data);
 
 	// Loops generating exact-trees.
 	for (;
 		// It will run until the maximum depth or until it finds a winning sequence for either player.
-		data->EXACT_DEPTH + board.moveCount <= 64 && (!stored_data || stored_data->score == DRAW);
+		data->EXACT_DEPTH + board.moveCount <= 64 && (!stored || stored_data.score == DRAW);
 		// After every run it increases the depth one step further.
 		data->EXACT_DEPTH++
 		)
@@ -445,18 +565,19 @@ static inline void main_loop_worker_exactSolver(Thread* self_thread, DATA* data,
 		self_thread->set_name(L"Worker EXACT: Depth %u H%llu", data->EXACT_DEPTH, board.hash);
 
 		// Computes the exact-tree as specified.
-		exactTree(board, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, data->EXACT_DEPTH, data->H_DATA.TT, (void*)data->H_DATA.HTT, data->NO_HTT_DEPTH, STOP);
+		exactTree(board, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, data->EXACT_DEPTH, data->H_DATA.TT, (void*)data->H_DATA.HTT, data->NO_HTT_DEPTH, STOP, data->H_DATA.ENDGAME);
 
 		// If the tree ended by force end the function.
 		if (*STOP)
 			goto end;
 
 		// Make sure loosing moves are not listed first
-		if (HTTEntry* e = data->H_DATA.HTT[board.moveCount].storedBoard(board.hash))
-			check_for_loosing_moves(board, data->H_DATA.TT, e);
+		HTTEntry e;
+		if (data->H_DATA.HTT->storedBoard(boardKey(board), e))
+			check_for_loosing_moves(board, data->H_DATA.TT, data->H_DATA.HTT, e);
 
 		// We check what data of the actual position we have on storage.
-		stored_data = data->H_DATA.TT[board.moveCount].storedBoard(board.hash);
+		stored = data->H_DATA.TT->storedBoard(boardKey(board), stored_data);
 
 	} --data->EXACT_DEPTH; // To keep depth consistent, oops!
 
@@ -464,32 +585,48 @@ static inline void main_loop_worker_exactSolver(Thread* self_thread, DATA* data,
 		goto end;
 
 	// If a solution was found in the current position the best path will be solved.
-	if (stored_data->score != DRAW)
+	if (stored_data.score != DRAW)
 	{
 		data->finding_solution = true;
 		*kill_heuristic = true;
 
-		HTTEntry* e = data->H_DATA.HTT[board.moveCount].probe(board.hash);
-		e->key = board.hash;
-		e->bitDepth = 255; // Temporary while it finds the actual solution depth.
-		e->heuDepth = 0;
-		e->flag = ENTRY_FLAG_EXACT;
-		e->eval = (float)stored_data->score;
-		e->order[0] = stored_data->bestCol;
+		HTTEntry e;
+		if (!read_entry(data->H_DATA.HTT, board, e))
+			memcpy(e.order, MOVE_ORDER<Board::WIDTH>.center, sizeof(e.order));
+
+		do
+		{
+			e.key = boardKey(board);
+			e.moveCount = board.moveCount;
+			e.bitDepth = 255; // Temporary while it finds the actual solution depth.
+			e.heuDepth = 0;
+			e.flag = ENTRY_FLAG_EXACT;
+			e.eval = (float)stored_data.score;
+			e.order[0] = stored_data.bestCol;
+		} while (!data->H_DATA.HTT->set(e));
 
 		// Sets the name to its own thread to the current state for reference.
 		self_thread->set_name(L"Worker EXACT: Pathfinding H%llu", board.hash);
 
-		char* solution = findBestPath(board, (SolveResult)stored_data->score, data->path_TT, STOP);
+		char* solution = findBestPath(board, (SolveResult)stored_data.score, data->path_TT, STOP);
 		if (*STOP)
 			goto end;
 
-		e->bitDepth = solution[1];
-		for (unsigned char c = 0; c < 8; c++)
-			if (e->order[c] == solution[0])
-				e->order[c] = e->order[0];
+		// The solution column is translated to the key orientation of the entry.
+		const unsigned char column = keyColumn(board, solution[0]);
 
-		e->order[0] = solution[0];
+		do
+		{
+			e.heuDepth = 0;
+			e.bitDepth = solution[1];
+			e.flag = ENTRY_FLAG_EXACT;
+			e.eval = (float)stored_data.score;
+			for (unsigned char c = 0; c < 8; c++)
+				if (e.order[c] == column)
+					e.order[c] = e.order[0];
+
+			e.order[0] = column;
+		} while (!data->H_DATA.HTT->set(e));
 		free(solution);
 
 		data->solution_found = true;
@@ -498,24 +635,30 @@ static inline void main_loop_worker_exactSolver(Thread* self_thread, DATA* data,
 	}
 
 	// If the final move was reached with no winner the position is solved, is a draw.
-	if (stored_data->depth + board.moveCount == 64)
+	if (stored_data.depth + board.moveCount == 64)
 	{
 		data->finding_solution = true;
 		*kill_heuristic = true;
 
-		HTTEntry* e = data->H_DATA.HTT[board.moveCount].probe(board.hash);
+		HTTEntry e;
+		if (!read_entry(data->H_DATA.HTT, board, e))
+			memcpy(e.order, MOVE_ORDER<Board::WIDTH>.center, sizeof(e.order));
 
-		e->key = board.hash;
-		e->bitDepth = stored_data->depth;
-		e->heuDepth = 0;
-		e->flag = ENTRY_FLAG_EXACT;
-		e->eval = (float)stored_data->score;
+		do
+		{
+			e.key = boardKey(board);
+			e.moveCount = board.moveCount;
+			e.bitDepth = stored_data.depth;
+			e.heuDepth = 0;
+			e.flag = ENTRY_FLAG_EXACT;
+			e.eval = (float)stored_data.score;
 
-		for (unsigned char c = 0; c < 8; c++)
-			if (e->order[c] == stored_data->bestCol)
-				e->order[c] = e->order[0];
+			for (unsigned char c = 0; c < 8; c++)
+				if (e.order[c] == stored_data.bestCol)
+					e.order[c] = e.order[0];
 
-		e->order[0] = stored_data->bestCol;
+			e.order[0] = stored_data.bestCol;
+		} while (!data->H_DATA.HTT->set(e));
 
 		data->solution_found = true;
 		data->finding_solution = false;
@@ -731,14 +874,48 @@ Constructor/Destructor functions
 -------------------------------------------------------------------------------------------------------
 */
 
+// Tells the tables the move count of the board under evaluation. Boards with less moves are
+// behind the game, so the tables replace their entries first, see TransTable::set_floor().
+
+static inline void set_table_floors(DATA* data)
+{
+	const uint8_t moveCount = data->currentBoard.moveCount;
+
+	data->H_DATA.HTT->set_floor(moveCount);
+	data->H_DATA.TT->set_floor(moveCount);
+	data->path_TT->set_floor(moveCount);
+}
+
+// Splits the memory budget of the engine between its transposition tables.
+// Each table holds the boards of every moveCount of the analyzed positions.
+// The tables found in the snapshot file, if any, are mapped instead of allocated.
+
+static inline void allocate_tables(DATA* data, size_t memory_mb, const char* tables_file)
+{
+	const size_t eighth = (memory_mb << 20) / 8;
+	data->memory_mb = memory_mb;
+
+	data->H_DATA.HTT = new HeuristicTransTable(0);
+	data->H_DATA.TT = new TransTable(0);
+	data->path_TT = new TransTable(eighth * PATH_TT_MEMORY_EIGHTHS);
+
+	if (!data->H_DATA.HTT->map(tables_file))
+		data->H_DATA.HTT->init(eighth * HTT_MEMORY_EIGHTHS);
+
+	if (!data->H_DATA.TT->map(tables_file))
+		data->H_DATA.TT->init(eighth * TT_MEMORY_EIGHTHS);
+
+	set_table_floors(data);
+}
+
 // Constructor, it calls the main loop to start analyzing the position.
 // If no position is provided it will default to initial position. If it
 // started suspended, resume needs to be called to start evaluating.
+// The transposition tables will share a budget of memory_mb megabytes, if a 
+// tables_file is provided the tables saved in it are mapped copy-on-write instead.
 
-EngineConnect4::EngineConnect4(const Connect4* position, const char* nn_weights_file, bool start_suspended)
+EngineConnect4::EngineConnect4(const Connect4* position, const char* nn_weights_file, bool start_suspended, size_t memory_mb, const char* tables_file)
 {
-	init_zobrist();
-
 	threadedData = (void*)new DATA;
 
 	DATA* data = (DATA*)threadedData;
@@ -766,9 +943,7 @@ EngineConnect4::EngineConnect4(const Connect4* position, const char* nn_weights_
 	}
 	data->updatedBoard = true;
 
-	data->H_DATA.TT = new TransTable[65];
-	data->H_DATA.HTT = new HeuristicTransTable[65];
-	data->path_TT = new TransTable[65];
+	allocate_tables(data, memory_mb, tables_file);
 
 	thread->start(&EngineConnect4::thread_entry, this);
 	thread->set_priority(Thread::PRIORITY_NORMAL);
@@ -778,11 +953,11 @@ EngineConnect4::EngineConnect4(const Connect4* position, const char* nn_weights_
 // Constructor, it calls the main loop to start analyzing the board.
 // If no board is provided it will default to initial position. If it
 // started suspended, resume needs to be called to start evaluating.
+// The transposition tables will share a budget of memory_mb megabytes, if a 
+// tables_file is provided the tables saved in it are mapped copy-on-write instead.
 
-EngineConnect4::EngineConnect4(const Board* board, const char* nn_weights_file, bool start_suspended)
+EngineConnect4::EngineConnect4(const Board* board, const char* nn_weights_file, bool start_suspended, size_t memory_mb, const char* tables_file)
 {
-	init_zobrist();
-
 	threadedData = (void*)new DATA;
 
 	DATA* data = (DATA*)threadedData;
@@ -805,9 +980,7 @@ EngineConnect4::EngineConnect4(const Board* board, const char* nn_weights_file,
 	}
 	data->updatedBoard = true;
 
-	data->H_DATA.TT = new TransTable[65];
-	data->H_DATA.HTT = new HeuristicTransTable[65];
-	data->path_TT = new TransTable[65];
+	allocate_tables(data, memory_mb, tables_file);
 
 	thread->start(&EngineConnect4::thread_entry, this);
 	thread->set_priority(Thread::PRIORITY_NORMAL);
@@ -817,11 +990,11 @@ EngineConnect4::EngineConnect4(const Board* board, const char* nn_weights_file,
 // Constructor, it calls the main loop to start analyzing the board.
 // If no board is provided it will default to initial position. If it
 // started suspended, resume needs to be called to start evaluating.
+// The transposition tables will share a budget of memory_mb megabytes, if a 
+// tables_file is provided the tables saved in it are mapped copy-on-write instead.
 
-EngineConnect4::EngineConnect4(const Board* board, NeuralNetwork* nn_scheduler, bool start_suspended)
+EngineConnect4::EngineConnect4(const Board* board, NeuralNetwork* nn_scheduler, bool start_suspended, size_t memory_mb, const char* tables_file)
 {
-	init_zobrist();
-
 	threadedData = (void*)new DATA;
 
 	DATA* data = (DATA*)threadedData;
@@ -844,9 +1017,7 @@ EngineConnect4::EngineConnect4(const Board* board, NeuralNetwork* nn_scheduler,
 	}
 	data->updatedBoard = true;
 
-	data->H_DATA.TT = new TransTable[65];
-	data->H_DATA.HTT = new HeuristicTransTable[65];
-	data->path_TT = new TransTable[65];
+	allocate_tables(data, memory_mb, tables_file);
 
 	thread->start(&EngineConnect4::thread_entry, this);
 	thread->set_priority(Thread::PRIORITY_NORMAL);
@@ -861,11 +1032,15 @@ EngineConnect4::~EngineConnect4()
 
 	DATA* data = (DATA*)threadedData;
 
+	// The views are deleted below, they do not release the pool memory.
+	if (data->pool)
+		data->pool->detach();
+
 	if (data->scheduler)
 		delete data->scheduler;
-	delete[] data->H_DATA.TT;
-	delete[] data->H_DATA.HTT;
-	delete[] data->path_TT;
+	delete data->H_DATA.TT;
+	delete data->H_DATA.HTT;
+	delete data->path_TT;
 
 	delete data;
 }
@@ -946,6 +1121,8 @@ bool EngineConnect4::update_position(const Board* board)
 	data->currentBoard = *board;
 	data->updatedBoard = true;
 	data->finding_solution = false;
+	set_table_floors(data);
+	check_opening_book(data);
 
 	bool game_ended =   is_win(data->currentBoard.playerBitboard[0]) ||
 						is_win(data->currentBoard.playerBitboard[1]) ||
@@ -972,7 +1149,8 @@ PositionEval EngineConnect4::get_evaluation(const Connect4* position) const
 
 	if (board)
 	{
-		PositionEval eval = obtainPosEvalFromEntry(data->H_DATA.HTT[board->moveCount].storedBoard(board->hash));
+		HTTEntry e;
+		PositionEval eval = obtainPosEvalFromEntry(*board, read_entry(data->H_DATA.HTT, *board, e) ? &e : nullptr);
 		if (position)
 			delete board;
 		return eval;
@@ -988,15 +1166,16 @@ PositionEval EngineConnect4::get_evaluation(const Board* board) const
 {
 	DATA* data = (DATA*)threadedData;
 
-	if (board)
-		return obtainPosEvalFromEntry(data->H_DATA.HTT[board->moveCount].storedBoard(board->hash));
+	if (!board)
+		board = &data->currentBoard;
 
-	return obtainPosEvalFromEntry(data->H_DATA.HTT[data->currentBoard.moveCount].storedBoard(data->currentBoard.hash));
+	HTTEntry e;
+	return obtainPosEvalFromEntry(*board, read_entry(data->H_DATA.HTT, *board, e) ? &e : nullptr);
 }
 
 // It returns a position evaluation after a specified time, you can either 
 // enter a new position or leave it at nullptr to maintain current position.
-// If it finds a forced win it will return immediately.
+// If it finds a forced win or the position is in the opening book it will return immediately.
 
 PositionEval EngineConnect4::evaluate_for(float seconds, const Connect4* position)
 {
@@ -1007,14 +1186,14 @@ PositionEval EngineConnect4::evaluate_for(float seconds, const Connect4* positio
 	if (position && !update_position(position))
 		return PositionEval(); // invalid
 
-	while (data->deadline - data->timer.check() > 0.f && !data->solution_found)
+	while (data->deadline - data->timer.check() > 0.f && !data->solution_found && !data->book_hit)
 		Thread::waitForWakeUp(CALL_MAINLOOP, 1UL);
 
 	return get_evaluation();
 }
 
-// It updates the current board, and it returns a board evaluation after
-// a specified time. If it finds a forced win it will return immediately.
+// It updates the current board, and it returns a board evaluation after a specified time.
+// If it finds a forced win or the board is in the opening book it will return immediately.
 
 PositionEval EngineConnect4::evaluate_for(float seconds, const Board* board, bool update_scheduler)
 {
@@ -1028,7 +1207,7 @@ PositionEval EngineConnect4::evaluate_for(float seconds, const Board* board, boo
 		return PositionEval(); // invalid
 
 
-	while (deadline - data->timer.check() > 0.f && !data->solution_found)
+	while (deadline - data->timer.check() > 0.f && !data->solution_found && !data->book_hit)
 		Thread::waitForWakeUp(CALL_MAINLOOP, 1UL);
 
 	return get_evaluation();
@@ -1044,15 +1223,16 @@ PositionEval EngineConnect4::evaluate_until_depth(unsigned char total_depth, con
 	if (position && !update_position(position))
 		return PositionEval(); // invalid
 
-	HTTEntry* e = data->H_DATA.HTT[data->currentBoard.moveCount].storedBoard(data->currentBoard.hash);
+	HTTEntry e;
+	bool stored = read_entry(data->H_DATA.HTT, data->currentBoard, e);
 
-	while ((!e || e->heuDepth + e->bitDepth < total_depth) && !data->solution_found)
+	while ((!stored || e.heuDepth + e.bitDepth < total_depth) && !data->solution_found)
 	{
-		e = data->H_DATA.HTT[data->currentBoard.moveCount].storedBoard(data->currentBoard.hash);
+		stored = read_entry(data->H_DATA.HTT, data->currentBoard, e);
 		Thread::waitForWakeUp(CALL_MAINLOOP, MAINLOOP_WAIT_TIME_MS);
 	}
 
-	return obtainPosEvalFromEntry(e);
+	return obtainPosEvalFromEntry(data->currentBoard, stored ? &e : nullptr);
 }
 
 // The new board is introduced and will not return a PositionEval until the depth
@@ -1065,33 +1245,212 @@ PositionEval EngineConnect4::evaluate_until_depth(unsigned char total_depth, con
 	if (board && !update_position(board))
 		return PositionEval(); // invalid
 
-	HTTEntry* e = data->H_DATA.HTT[data->currentBoard.moveCount].storedBoard(data->currentBoard.hash);
+	HTTEntry e;
+	bool stored = read_entry(data->H_DATA.HTT, data->currentBoard, e);
 
-	while ((!e || e->heuDepth + e->bitDepth < total_depth) && !data->solution_found)
+	while ((!stored || e.heuDepth + e.bitDepth < total_depth) && !data->solution_found)
 	{
-		e = data->H_DATA.HTT[data->currentBoard.moveCount].storedBoard(data->currentBoard.hash);
+		stored = read_entry(data->H_DATA.HTT, data->currentBoard, e);
 		Thread::waitForWakeUp(CALL_MAINLOOP, MAINLOOP_WAIT_TIME_MS);
 	}
 
-	return obtainPosEvalFromEntry(e);
+	return obtainPosEvalFromEntry(data->currentBoard, stored ? &e : nullptr);
+}
+
+// Copies the HTTEntry of the specified board into entry, returns false if it is not stored.
+// Stored columns are seen from the key orientation, see keyColumn().
+
+bool EngineConnect4::get_entry(const Board* board, HTTEntry& entry) const
+{
+	DATA* data = (DATA*)threadedData;
+
+	return data->H_DATA.HTT->storedBoard(boardKey(*board), entry);
+}
+
+// Copies the TTEntry of the specified board into entry, returns false if it is not stored.
+// Stored columns are seen from the key orientation, see keyColumn().
+
+bool EngineConnect4::get_exact_entry(const Board* board, TTEntry& entry) const
+{
+	DATA* data = (DATA*)threadedData;
+
+	return data->H_DATA.TT->storedBoard(boardKey(*board), entry);
+}
+
+// Copies the statistics of the exact and heuristic transposition tables. 
+// The engine keeps running, so the counters are read while they change.
+
+void EngineConnect4::get_table_stats(TTStats& exact, TTStats& heuristic) const
+{
+	DATA* data = (DATA*)threadedData;
+
+	exact = data->H_DATA.TT->stats();
+	heuristic = data->H_DATA.HTT->stats();
+}
+
+// Sets the probe and store counters of both transposition tables back to zero.
+
+void EngineConnect4::reset_table_stats() const
+{
+	DATA* data = (DATA*)threadedData;
+
+	data->H_DATA.TT->reset_stats();
+	data->H_DATA.HTT->reset_stats();
+}
+
+// Saves the exact and heuristic transposition tables into a snapshot file, 
+// the engine is suspended so the tables do not change while being written.
+
+bool EngineConnect4::save_tables(const char* tables_file) const
+{
+	DATA* data = (DATA*)threadedData;
+
+	bool was_suspended = data->suspended;
+	suspend();
+
+	const SnapshotTable tables[] = { data->H_DATA.TT->snapshot(), data->H_DATA.HTT->snapshot() };
+	const bool saved = saveSnapshot(tables_file, tables, 2);
+
+	if (!was_suspended)
+		resume();
+
+	return saved;
+}
+
+// Maps the tables saved in a snapshot file in place of the current ones. 
+// The workers start again from scratch, with the tables already warm.
+
+bool EngineConnect4::load_tables(const char* tables_file, bool copy_on_write)
+{
+	DATA* data = (DATA*)threadedData;
+
+	// The tables of a pool are shared, they can not be replaced by a single engine.
+	if (data->pool)
+		return false;
+
+	bool was_suspended = data->suspended;
+	suspend();
+
+	const bool mapped_TT = data->H_DATA.TT->map(tables_file, copy_on_write);
+	const bool mapped_HTT = data->H_DATA.HTT->map(tables_file, copy_on_write);
+	set_table_floors(data);
+	data->updatedBoard = true;
+
+	if (!was_suspended)
+		resume();
+
+	return mapped_TT || mapped_HTT;
+}
+
+// Maps an opening book and looks for the current position in it. The engine is 
+// suspended so the tables are not being searched while the book entries are seeded.
+
+bool EngineConnect4::load_book(const char* book_file)
+{
+	DATA* data = (DATA*)threadedData;
+
+	bool was_suspended = data->suspended;
+	suspend();
+
+	const bool opened = book_file && data->book.open(book_file);
+	if (!opened)
+		data->book.close();
+
+	check_opening_book(data);
+	data->updatedBoard = true;
+
+	if (!was_suspended)
+		resume();
+
+	return opened;
+}
+
+// Maps an endgame database and hands it to the exact solvers of this engine. The engine is
+// suspended so none of its trees is probing the database while it is replaced.
+
+bool EngineConnect4::load_endgame(const char* endgame_file, unsigned char from_moves)
+{
+	DATA* data = (DATA*)threadedData;
+
+	bool was_suspended = data->suspended;
+	suspend();
+
+	data->H_DATA.ENDGAME = nullptr;
+
+	// Databases of other board types are refused, their keys mean nothing here.
+	bool opened = endgame_file && data->endgame.open(endgame_file, from_moves);
+	if (opened && data->endgame.kind() != endgameKind<Board>())
+	{
+		data->endgame.close();
+		opened = false;
+	}
+	if (opened)
+		data->H_DATA.ENDGAME = &data->endgame;
+
+	if (!was_suspended)
+		resume();
+
+	return opened;
 }
 
-// Returns the HTTEntry* to the transposition table for the specified board.
+// Attaches the engine tables to a pool, or gives it back its own tables if the pool is nullptr.
+// The engine is suspended so the tables are not being searched while they are replaced.
 
-HTTEntry* EngineConnect4::get_entry(const Board* board) const
+void EngineConnect4::attach_tables(TablePool* pool, unsigned owner)
 {
 	DATA* data = (DATA*)threadedData;
 
-	return data->H_DATA.HTT[board->moveCount].storedBoard(board->hash);
+	bool was_suspended = data->suspended;
+	suspend();
+
+	if (data->pool)
+		data->pool->detach();
+	data->pool = pool;
+
+	if (pool)
+		pool->attach(*data->H_DATA.TT, *data->H_DATA.HTT, *data->path_TT, owner);
+	else
+	{
+		const size_t eighth = (data->memory_mb << 20) / 8;
+
+		data->H_DATA.HTT->init(eighth * HTT_MEMORY_EIGHTHS);
+		data->H_DATA.TT->init(eighth * TT_MEMORY_EIGHTHS);
+		data->path_TT->init(eighth * PATH_TT_MEMORY_EIGHTHS);
+		set_table_floors(data);
+	}
+
+	check_opening_book(data);
+	data->updatedBoard = true;
+
+	if (!was_suspended)
+		resume();
 }
 
-// Returns the TTEntry* to the transposition table for the specified board.
+// Makes the engine tables overlays of the parent ones, or stops reading them if nullptr.
+// Only this engine is suspended, the parent keeps searching while the fork reads its tables.
 
-TTEntry* EngineConnect4::get_exact_entry(const Board* board) const
+bool EngineConnect4::fork_tables(const EngineConnect4* parent)
 {
 	DATA* data = (DATA*)threadedData;
+	const DATA* parent_data = parent ? (const DATA*)parent->threadedData : nullptr;
 
-	return data->H_DATA.TT[board->moveCount].storedBoard(board->hash);
+	if (parent == this)
+		return false;
+
+	bool was_suspended = data->suspended;
+	suspend();
+
+	data->H_DATA.HTT->fork(parent_data ? parent_data->H_DATA.HTT : nullptr);
+	data->H_DATA.TT->fork(parent_data ? parent_data->H_DATA.TT : nullptr);
+	data->path_TT->fork(parent_data ? parent_data->path_TT : nullptr);
+
+	check_opening_book(data);
+	data->updatedBoard = true;
+
+	if (!was_suspended)
+		resume();
+
+	return true;
 }
 
 // Sets the weights for the Neural Network that schedules tree calls to the ones 
@@ -3,23 +3,11 @@
 
 #define KILL_TEST if(stop && *stop)return DRAW
 
-// Preferred move order for better pruning depending on the first column
-
-constexpr unsigned char moveOrder[8][8] =
-{
-	{ 0,3,4,2,5,1,6,7 },
-	{ 1,3,4,2,5,6,0,7 },
-	{ 2,3,4,5,1,6,0,7 },
-	{ 3,4,2,5,1,6,0,7 },
-	{ 4,3,2,5,1,6,0,7 },
-	{ 5,3,4,2,1,6,0,7 },
-	{ 6,3,4,2,5,1,0,7 },
-	{ 7,3,4,2,5,1,6,0 },
-};
-
 // The transposition table used by solve board is defined as a global 
 // so that the function retrieve column can also access it.
+// There is one per board type, since boards of different sizes share hashes.
 
+template<typename BoardType>
 static inline TransTable* TT = nullptr;
 
 // ----------------------------------------------------------------------------------------------------------
@@ -49,11 +37,36 @@ static inline TransTable* TT = nullptr;
 //
 // ----------------------------------------------------------------------------------------------------------
 
+#ifdef _TT_LOCAL
+// Returns the table private to the calling thread for the nodes close to the leaves, see
+// TT_LOCAL_DEPTH. There is one per board type, since boards of different sizes share hashes.
+// Its entries are never seen by other threads, so they outlive the clears of the shared tables,
+// they are still valid since they only depend on the board.
+
+template<typename BoardType>
+static inline TransTable* localTT()
+{
+	static thread_local TransTable table(TT_LOCAL_SIZE);
+	return &table;
+}
+#endif
+
+// Prefetches the TT buckets of the boards reached by the candidate moves. It is called before
+// searching the first child, so the other children find their buckets already in cache.
+
+template<typename BoardType>
+static inline void prefetchChildren(const BoardType& board, uint64_t candidates, const TransTable* TT)
+{
+	for (; candidates; candidates &= candidates - 1)
+		TT->prefetch(childKey(board, columnOf(candidates)));
+}
+
 // This is the main function of this file.
 // It solves a given position up to a certain depth, returns win, loss or draw.
 // Uses transposition tables, with best move ordering and alpha beta pruning
 
-inline SolveResult exactTree(Board& board, SolveResult alpha, SolveResult beta, unsigned char depth, TransTable* TT, void* HTT, unsigned char no_HTT_depth, bool* stop)
+template<typename BoardType>
+SolveResult exactTree(BoardType& board, SolveResult alpha, SolveResult beta, unsigned char depth, TransTable* TT, void* HTT, unsigned char no_HTT_depth, bool* stop, const EndgameDatabase* endgame)
 {
 	KILL_TEST;
 
@@ -68,19 +81,28 @@ inline SolveResult exactTree(Board& board, SolveResult alpha, SolveResult beta,
 	// If we know that our upper bound is lower than our alpha we return the value
 	// Else if it is smaller than our current beta we adjust beta
 
-	unsigned char colTT = 3u;
+#ifdef _TT_LOCAL
+	if (depth <= TT_LOCAL_DEPTH)
+		TT = localTT<BoardType>();
+#endif
+
+	unsigned char colTT = MOVE_ORDER<BoardType::WIDTH>.center[0];
+
+	const uint8_t moveCount = playedMoves(board);
+	const uint64_t key = boardKey(board);
+	const uint64_t moves = legalMoves(board);
 
-	TTEntry* storedData = TT[board.moveCount].storedBoard(board.hash);
+	TTEntry storedData;
 
-	if (storedData)
+	if (TT->storedBoard(key, storedData))
 	{
-		SolveResult score = (SolveResult)storedData->score;
+		SolveResult score = (SolveResult)storedData.score;
 
 		if (score)
 			return score;
 
-		else if (storedData->depth >= depth) 
-			switch (storedData->flag)
+		else if (storedData.depth >= depth) 
+			switch (storedData.flag)
 			{
 			case ENTRY_FLAG_EXACT: // Exact value known
 				return score;
@@ -98,56 +120,85 @@ inline SolveResult exactTree(Board& board, SolveResult alpha, SolveResult beta,
 
 		// Tree cutoff
 
-		if (depth == 1u || board.moveCount == 63u)
+		if (depth == 1u || moveCount == BoardType::CELLS - 1)
 			return DRAW;
 
-		colTT = storedData->bestCol;
+		colTT = keyColumn(board, storedData.bestCol);
+
+		// The TT only verifies part of the key, a column from another board
+		// must not index past the move order of this one.
+		if (colTT >= BoardType::WIDTH)
+			colTT = MOVE_ORDER<BoardType::WIDTH>.center[0];
 	}
 	else
 	{
-		// Checks if a move is winning for the current player or the other player
-		// Returns wins from our player and counts possible wins of the other player
+		// Checks if a move is winning for the current player, the board threats
+		// already hold every cell that completes a connect4, so a single and is enough.
 		// Wins are checked here so there is no need to check them anywhere else
 
-		unsigned char validCol;
-		for (unsigned char column : moveOrder[colTT])
+		const uint64_t wins = moves & currentThreats(board);
+
+		if (wins)
 		{
-			if (!canPlay(board, column))
-				continue;
+			const unsigned char winCol = keyColumn(board, columnOf(wins));
 
-			validCol = column;
-			const uint64_t s = bit_at(column, board.heights[column]);
+			if (HTT && depth > no_HTT_depth)
+				((HeuristicTransTable*)HTT)->store(key, winCol, (float)CURRENT_PLAYER_WIN, 0u, 1u, ENTRY_FLAG_EXACT, moveCount);
+			return (SolveResult)TT->store(key, 1u, CURRENT_PLAYER_WIN, ENTRY_FLAG_EXACT, winCol, moveCount);
+		}
 
-			if (is_win(board.playerBitboard[board.sideToPlay] | s))
-			{
-				if (HTT && depth > no_HTT_depth)
-					((HeuristicTransTable*)HTT)[board.moveCount].store(board.hash, column, (float)CURRENT_PLAYER_WIN, 0u, 1u, ENTRY_FLAG_EXACT);
-				return (SolveResult)TT[board.moveCount].store(board.hash, 1u, CURRENT_PLAYER_WIN, ENTRY_FLAG_EXACT, column);
-			}
+		// Solved positions of the endgame database are exact whatever the depth, the database
+		// does not hold the best column so the rightmost legal one is stored like on cutoffs.
 
+		int8_t solved;
+		if (endgame && endgame->covers<BoardType>(moveCount) && endgame->probe(key, solved))
+		{
+			const SolveResult result = solved > 0 ? CURRENT_PLAYER_WIN : solved < 0 ? OTHER_PLAYER_WIN : DRAW;
+			return (SolveResult)TT->store(key, BoardType::CELLS - moveCount, result, ENTRY_FLAG_EXACT, keyColumn(board, (unsigned char)((63 - std::countl_zero(moves)) >> 3)), moveCount);
 		}
 
-		// Tree cutoff
+		// Tree cutoff, the rightmost legal column is stored as the best one
+
+		if (depth == 1u || moveCount == BoardType::CELLS - 1)
+			return (SolveResult)TT->store(key, depth, DRAW, ENTRY_FLAG_EXACT, keyColumn(board, (unsigned char)((63 - std::countl_zero(moves)) >> 3)), moveCount);
+	}
+
+	// Moves that let the opponent win right away are never worth searching.
+	// If the opponent has a forced win no matter what we play, the position 
+	// is lost and there is no need to generate any children.
+
+	const uint64_t candidates = nonLosingMoves(board);
+
+	if (!candidates)
+	{
+		const unsigned char lostCol = keyColumn(board, columnMove(moves, colTT) ? colTT : columnOf(moves));
 
-		if (depth == 1u || board.moveCount == 63u)
-			return (SolveResult)TT[board.moveCount].store(board.hash, depth, DRAW, ENTRY_FLAG_EXACT, validCol);
+		if (HTT && depth > no_HTT_depth)
+			((HeuristicTransTable*)HTT)->store(key, lostCol, (float)OTHER_PLAYER_WIN, 0, 2u, ENTRY_FLAG_EXACT, moveCount);
+		return (SolveResult)TT->store(key, 2u, OTHER_PLAYER_WIN, ENTRY_FLAG_EXACT, lostCol, moveCount);
 	}
 
+#ifdef _TT_PREFETCH
+	prefetchChildren(board, candidates, TT);
+#endif
+
 	// Usual alphe-beta pruning recursive algorithm
-	// Moves are ordered starting from the column suggested by the TT
+	// Moves are ordered starting from the column suggested by the TT,
+	// followed by the preferred order for the width of the board.
 
 	unsigned char bestCol = colTT;
 	SolveResult best = INVALID_BOARD;
 	const SolveResult alpha0 = alpha;
+	const uint64_t state = moveState(board);
 
-	for (unsigned char column : moveOrder[colTT])
+	for (unsigned char column : MOVE_ORDER<BoardType::WIDTH>.column[colTT])
 	{
-		if (!canPlay(board, column))
+		if (!columnMove(candidates, column))
 			continue;
 
 		playMove(board, column);
-		const SolveResult score = -exactTree(board, -beta, -alpha, depth - 1, TT, HTT, no_HTT_depth, stop);
-		undoMove(board, column);
+		const SolveResult score = -exactTree(board, -beta, -alpha, depth - 1, TT, HTT, no_HTT_depth, stop, endgame);
+		undoMove(board, column, state);
 
 		KILL_TEST;
 
@@ -161,71 +212,196 @@ inline SolveResult exactTree(Board& board, SolveResult alpha, SolveResult beta,
 				alpha = best;
 				if (alpha >= beta)
 				{
+					bestCol = keyColumn(board, bestCol);
 					if (HTT && best && depth > no_HTT_depth)
-						((HeuristicTransTable*)HTT)[board.moveCount].store(board.hash, bestCol, (float)best, 0, depth, ENTRY_FLAG_EXACT);
-					return (SolveResult)TT[board.moveCount].store(board.hash, depth, best, best ? ENTRY_FLAG_EXACT : ENTRY_FLAG_LOWER, bestCol);
+						((HeuristicTransTable*)HTT)->store(key, bestCol, (float)best, 0, depth, ENTRY_FLAG_EXACT, moveCount);
+					return (SolveResult)TT->store(key, depth, best, best ? ENTRY_FLAG_EXACT : ENTRY_FLAG_LOWER, bestCol, moveCount);
 				}
 			}
 		}
 	}
 
 	// Before returning it always saves the position in the TT
+	bestCol = keyColumn(board, bestCol);
 	if (HTT && best && depth > no_HTT_depth)
-		((HeuristicTransTable*)HTT)[board.moveCount].store(board.hash, bestCol, (float)best, 0, depth, ENTRY_FLAG_EXACT);
-	return (SolveResult)TT[board.moveCount].store(board.hash, depth, best, (best <= alpha0 && !best) ? ENTRY_FLAG_UPPER : ENTRY_FLAG_EXACT, bestCol);
+		((HeuristicTransTable*)HTT)->store(key, bestCol, (float)best, 0, depth, ENTRY_FLAG_EXACT, moveCount);
+	return (SolveResult)TT->store(key, depth, best, (best <= alpha0 && !best) ? ENTRY_FLAG_UPPER : ENTRY_FLAG_EXACT, bestCol, moveCount);
+}
+
+// Same alpha-beta pruning algorithm as exactTree but the scores also encode when the game ends,
+// see distanceScore(). A single search finds the fastest win or the longest defence.
+// Its TT entries store distance scores, so it can not share a TT with exactTree.
+
+template<typename BoardType>
+int8_t distanceTree(BoardType& board, int8_t alpha, int8_t beta, unsigned char depth, TransTable* TT, bool* stop)
+{
+	KILL_TEST;
+
+	const uint8_t moveCount = playedMoves(board);
+	const uint64_t key = boardKey(board);
+	const uint64_t moves = legalMoves(board);
+
+	if (!depth || moveCount == BoardType::CELLS)
+		return DRAW;
+
+	// Same transposition table check as exactTree. The depth does not matter for wins
+	// that are at least that good or losses that are at least that bad, they come from
+	// forced lines that end the game before the depth is reached.
+
+	unsigned char colTT = MOVE_ORDER<BoardType::WIDTH>.center[0];
+	TTEntry storedData;
+
+	if (TT->storedBoard(key, storedData))
+	{
+		const int8_t score = storedData.score;
+
+		if (storedData.depth >= depth || (score > 0 && storedData.flag != ENTRY_FLAG_UPPER) || (score < 0 && storedData.flag != ENTRY_FLAG_LOWER))
+			switch (storedData.flag)
+			{
+			case ENTRY_FLAG_EXACT: // Exact value known
+				return score;
+
+			case ENTRY_FLAG_LOWER: // Lower bound (at least)
+				if (score >= beta) return score;
+				if (score > alpha) alpha = score;
+				break;
+
+			case ENTRY_FLAG_UPPER: // Upper bound (up most)
+				if (score <= alpha) return score;
+				if (score < beta) beta = score;
+				break;
+			}
+
+		colTT = keyColumn(board, storedData.bestCol);
+
+		// The TT only verifies part of the key, a column from another board
+		// must not index past the move order of this one.
+		if (colTT >= BoardType::WIDTH)
+			colTT = MOVE_ORDER<BoardType::WIDTH>.center[0];
+	}
+
+	// Checks if a move is winning for the current player, it is the fastest possible win.
+
+	if (const uint64_t wins = moves & currentThreats(board))
+		return (int8_t)TT->store(key, depth, distanceScore<BoardType>(moveCount + 1), ENTRY_FLAG_EXACT, keyColumn(board, columnOf(wins)), moveCount);
+
+	// Tree cutoff, the rightmost legal column is stored as the best one
+
+	if (depth == 1u || moveCount == BoardType::CELLS - 1)
+		return (int8_t)TT->store(key, depth, DRAW, ENTRY_FLAG_EXACT, keyColumn(board, (unsigned char)((63 - std::countl_zero(moves)) >> 3)), moveCount);
+
+	// If every move lets the opponent win the game ends with its next move.
+
+	const uint64_t candidates = nonLosingMoves(board);
+
+	if (!candidates)
+	{
+		const unsigned char lostCol = keyColumn(board, columnMove(moves, colTT) ? colTT : columnOf(moves));
+		return (int8_t)TT->store(key, depth, -distanceScore<BoardType>(moveCount + 2), ENTRY_FLAG_EXACT, lostCol, moveCount);
+	}
+
+	// Mate distance pruning: from here the fastest win is our next move after the opponent's,
+	// and the opponent can not win before its second move, so the window can be narrowed.
+	// When the board fills up before that the best and worst outcome is a draw.
+
+	const int8_t maxScore = moveCount + 3 <= BoardType::CELLS ?  distanceScore<BoardType>(moveCount + 3) : (int8_t)DRAW;
+	const int8_t minScore = moveCount + 4 <= BoardType::CELLS ? -distanceScore<BoardType>(moveCount + 4) : (int8_t)DRAW;
+
+	if (beta > maxScore)
+	{
+		beta = maxScore;
+		if (alpha >= beta) return beta;
+	}
+	if (alpha < minScore)
+	{
+		alpha = minScore;
+		if (alpha >= beta) return alpha;
+	}
+
+#ifdef _TT_PREFETCH
+	prefetchChildren(board, candidates, TT);
+#endif
+
+	// Usual alpha-beta pruning recursive algorithm
+
+	unsigned char bestCol = colTT;
+	int8_t best = INT8_MIN;
+	const int8_t alpha0 = alpha;
+	const uint64_t state = moveState(board);
+
+	for (unsigned char column : MOVE_ORDER<BoardType::WIDTH>.column[colTT])
+	{
+		if (!columnMove(candidates, column))
+			continue;
+
+		playMove(board, column);
+		const int8_t score = -distanceTree(board, -beta, -alpha, depth - 1, TT, stop);
+		undoMove(board, column, state);
+
+		KILL_TEST;
+
+		if (score > best)
+		{
+			best = score;
+			bestCol = column;
+
+			if (best > alpha)
+			{
+				alpha = best;
+				if (alpha >= beta)
+					return (int8_t)TT->store(key, depth, best, ENTRY_FLAG_LOWER, keyColumn(board, bestCol), moveCount);
+			}
+		}
+	}
+
+	return (int8_t)TT->store(key, depth, best, best <= alpha0 ? ENTRY_FLAG_UPPER : ENTRY_FLAG_EXACT, keyColumn(board, bestCol), moveCount);
 }
 
 // Solves the given board position up to a certain depth.
 // It checks the validity of the board and then initializes the alpha-beta pruning tree.
 
-SolveResult solveBoard(const Board& initialBoard, unsigned char depth, TransTable* givenTT)
+template<typename BoardType>
+SolveResult solveBoard(const BoardType& initialBoard, unsigned char depth, TransTable* givenTT, const EndgameDatabase* endgame)
 {
-	init_zobrist();
-
 	if (invalidBoard(initialBoard))
 		return INVALID_BOARD;
 
-	if (is_win(initialBoard.playerBitboard[initialBoard.sideToPlay]))
+	if (is_win(currentPieces(initialBoard)))
 		return CURRENT_PLAYER_WIN;
 
-	if (is_win(initialBoard.playerBitboard[initialBoard.sideToPlay ^ 1]))
+	if (is_win(otherPieces(initialBoard)))
 		return OTHER_PLAYER_WIN;
 
-	Board board = initialBoard;
-
-	if (depth > 64 - board.moveCount)
-		depth = 64 - board.moveCount;
+	BoardType board = initialBoard;
+	const uint8_t moveCount = playedMoves(board);
 
-	TransTable*		usingTT;
-	if (givenTT)	usingTT = givenTT;
-	else if (TT)	usingTT = TT;
-	else			usingTT = (TT = (TransTable*)calloc(64, sizeof(TransTable)));
+	if (depth > BoardType::CELLS - moveCount)
+		depth = BoardType::CELLS - moveCount;
 
-	for (int d = board.moveCount; d < board.moveCount + depth; d++)
-		if (!usingTT[d].is_init())
-			usingTT[d].init();
+	TransTable*				usingTT;
+	if (givenTT)			usingTT = givenTT;
+	else if (TT<BoardType>)	usingTT = TT<BoardType>;
+	else					usingTT = (TT<BoardType> = new TransTable());
 
-	return exactTree(board, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, depth, TT, nullptr, 0, nullptr);
+	return exactTree(board, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, depth, usingTT, nullptr, 0, nullptr, endgame);
 }
 
 // Same as the previous one but assumes validity checks have been done.
 // Used for win checks on bigger heuristic trees.
 
-SolveResult noChecksSolveBoard(const Board& initialBoard, unsigned char depth, TransTable* givenTT)
+template<typename BoardType>
+SolveResult noChecksSolveBoard(const BoardType& initialBoard, unsigned char depth, TransTable* givenTT)
 {
-	Board board = initialBoard;
-
-	if (depth > 64 - board.moveCount)
-		depth = 64 - board.moveCount;
+	BoardType board = initialBoard;
+	const uint8_t moveCount = playedMoves(board);
 
-	TransTable*		usingTT;
-	if (givenTT)	usingTT = givenTT;
-	else if (TT)	usingTT = TT;
-	else			usingTT = (TT = (TransTable*)calloc(64, sizeof(TransTable)));
+	if (depth > BoardType::CELLS - moveCount)
+		depth = BoardType::CELLS - moveCount;
 
-	for (int d = board.moveCount; d < board.moveCount + depth; d++)
-		if (!usingTT[d].is_init())
-			usingTT[d].init();
+	TransTable*				usingTT;
+	if (givenTT)			usingTT = givenTT;
+	else if (TT<BoardType>)	usingTT = TT<BoardType>;
+	else					usingTT = (TT<BoardType> = new TransTable());
 
 	return exactTree(board, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, depth, usingTT, nullptr, 0, nullptr);
 }
@@ -233,77 +409,148 @@ SolveResult noChecksSolveBoard(const Board& initialBoard, unsigned char depth, T
 // If the position is stored on the transposition table it retrieves the best column.
 // if the position is a mate situation it does not guarantee best path.
 
-unsigned char retrieveColumn(const Board& board, TransTable* givenTT)
+template<typename BoardType>
+unsigned char retrieveColumn(const BoardType& board, TransTable* givenTT)
 {
 	TransTable*		usingTT;
-	if (!givenTT)	usingTT = TT;
+	if (!givenTT)	usingTT = TT<BoardType>;
 	else			usingTT = givenTT;
 
-	if (!usingTT || !usingTT[board.moveCount].is_init())
+	if (!usingTT || !usingTT->is_init())
 		return 255;
 
-	TTEntry* entry = usingTT[board.moveCount].storedBoard(board.hash);
+	TTEntry entry;
 
-	if (!entry)
+	if (!usingTT->storedBoard(boardKey(board), entry))
 		return 255;
 
-	return entry->bestCol;
+	return keyColumn(board, entry.bestCol);
 }
 
 // If there is a forced win by any of the players it will find the best move.
 // For the winning player is the one that wins the fastest.
 // For the losing player is the one that delays the loss the longest.
 // First value is the column second value is the distance.
+// 
+// The distance scores make the first depth that sees the end of the game the exact
+// distance, so the TT is not cleared, wins and losses found by previous calls and
+// previous depths stay valid and only the last depth is searched with a full window.
 
-char* findBestPath(const Board& board, SolveResult WhoWins, TransTable* givenTT, bool* stop)
+template<typename BoardType>
+char* findBestPath(const BoardType& board, SolveResult WhoWins, TransTable* givenTT, bool* stop)
 {
-	Board b = board;
+	BoardType b = board;
+	const uint8_t moveCount = playedMoves(board);
+	const unsigned char depth = BoardType::CELLS - moveCount;
 
 	if(!givenTT)
 	{
-		static TransTable* staticTT = new TransTable[64];
+		static TransTable* staticTT = new TransTable();
 		givenTT = staticTT;
 	}
 
-	for (unsigned char d = board.moveCount; d < 64; d++)
-		givenTT[d].clear();
-
-	SolveResult result = DRAW;
-	unsigned char depth = 0u;
-	while (!result && depth + board.moveCount < 64)
+	int8_t alpha, beta;
+	switch (WhoWins)
 	{
-		if (stop && *stop)
-			return nullptr;
-
-		depth++;
+	case CURRENT_PLAYER_WIN:
+		alpha = DRAW;
+		beta = BoardType::CELLS;
+		break;
+
+	case OTHER_PLAYER_WIN:
+		alpha = -BoardType::CELLS;
+		beta = DRAW;
+		break;
+
+	case DRAW:
+		alpha = -BoardType::CELLS;
+		beta = BoardType::CELLS;
+		break;
+
+	default:
+		return nullptr;
+	}
 
-		switch (WhoWins)
-		{
-		case CURRENT_PLAYER_WIN:
-			result = exactTree(b, DRAW, CURRENT_PLAYER_WIN, depth, givenTT, nullptr, 0, stop);
-			break;
+	// Null window searches deepen until the first one that sees the end of the game,
+	// then the full window search at that depth finds the best move.
+	// A bound left in the TT by a previous call can end the loop before that depth,
+	// the distance of the bound is the depth the full window search needs to see it.
+	const int8_t nullAlpha = (WhoWins == OTHER_PLAYER_WIN) ? -1 : DRAW;
 
-		case OTHER_PLAYER_WIN:
-			result = exactTree(b, OTHER_PLAYER_WIN, DRAW, depth, givenTT, nullptr, 0, stop);
+	unsigned char d = 1;
+	for (; d < depth; d++)
+	{
+		const int8_t bound = distanceTree(b, nullAlpha, (int8_t)(nullAlpha + 1), d, givenTT, stop);
+		if (stop && *stop)
 			break;
 
-		case DRAW:
-			result = exactTree(b, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, depth, givenTT, nullptr, 0, stop);
+		if (bound != DRAW)
+		{
+			const unsigned char distance = scoreDistance<BoardType>(bound, moveCount);
+			if (distance > d)
+				d = distance < depth ? distance : depth;
 			break;
-
-		default:
-			return nullptr;
 		}
-		
 	}
+
+	const int8_t score = distanceTree(b, alpha, beta, d, givenTT, stop);
+
 	if (stop && *stop)
 		return nullptr;
 
+	// The root is only missing when the window was already closed near a full board,
+	// in that case any legal move is as good as the others.
+	TTEntry root;
+	const bool rootFound = givenTT->storedBoard(boardKey(board), root);
+
 	char* solution = (char*)calloc(3, sizeof(char));
-	solution[0] = givenTT[board.moveCount].storedBoard(board.hash)->bestCol;
-	solution[1] = depth;
-	solution[2] = (char)result;
- 
+	solution[0] = rootFound ? keyColumn(board, root.bestCol) : columnOf(legalMoves(board));
+	solution[1] = score ? scoreDistance<BoardType>(score, moveCount) : depth;
+	solution[2] = (char)(score > 0 ? CURRENT_PLAYER_WIN : score < 0 ? OTHER_PLAYER_WIN : DRAW);
 
 	return solution;
 }
+
+// Solves the board with the distance solver and adds its score to the builder.
+// The distance of findBestPath is turned back into the distance score of the board.
+
+template<typename BoardType>
+bool collectEndgame(const BoardType& board, EndgameBuilder& builder, TransTable* givenTT, bool* stop)
+{
+	if (builder.kind() != endgameKind<BoardType>() || invalidBoard(board) || is_win(currentPieces(board)) || is_win(otherPieces(board)))
+		return false;
+
+	const uint8_t moveCount = playedMoves(board);
+	if (moveCount == BoardType::CELLS)
+		return false;
+
+	char* solution = findBestPath(board, DRAW, givenTT, stop);
+	if (!solution)
+		return false;
+
+	const unsigned char ply = moveCount + (unsigned char)solution[1];
+	int8_t score = DRAW;
+
+	if (solution[2] == CURRENT_PLAYER_WIN)
+		score = distanceScore<BoardType>(ply);
+	else if (solution[2] == OTHER_PLAYER_WIN)
+		score = -distanceScore<BoardType>(ply);
+
+	free(solution);
+	return builder.add(boardKey(board), score);
+}
+
+// Explicit instantiations of the solver for every supported board representation.
+
+#define INSTANTIATE_BIT_SOLVER(BoardType) \
+	template SolveResult exactTree<BoardType>(BoardType&, SolveResult, SolveResult, unsigned char, TransTable*, void*, unsigned char, bool*, const EndgameDatabase*); \
+	template int8_t distanceTree<BoardType>(BoardType&, int8_t, int8_t, unsigned char, TransTable*, bool*); \
+	template SolveResult solveBoard<BoardType>(const BoardType&, unsigned char, TransTable*, const EndgameDatabase*); \
+	template SolveResult noChecksSolveBoard<BoardType>(const BoardType&, unsigned char, TransTable*); \
+	template unsigned char retrieveColumn<BoardType>(const BoardType&, TransTable*); \
+	template char* findBestPath<BoardType>(const BoardType&, SolveResult, TransTable*, bool*); \
+	template bool collectEndgame<BoardType>(const BoardType&, EndgameBuilder&, TransTable*, bool*);
+
+INSTANTIATE_BIT_SOLVER(Board)
+INSTANTIATE_BIT_SOLVER(Board7x6)
+INSTANTIATE_BIT_SOLVER(CompactBoard7x6)
\ No newline at end of file
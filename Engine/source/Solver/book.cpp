@@ -0,0 +1,253 @@
+#include "book.h"
+#include "heuristicSolver.h"
+#include "Thread.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+// The book only holds positions of games started by the first player (sideToPlay 0),
+// so the side to play of every position is the parity of its move count.
+
+/*
+-------------------------------------------------------------------------------------------------------
+Internal structures
+-------------------------------------------------------------------------------------------------------
+*/
+
+// A position of the book while it is built, stored compact to keep the levels small.
+struct BookPosition
+{
+	uint64_t key;			// Key of the board, see boardKey()
+	CompactBoard board;		// The board itself
+};
+
+// Growable array of positions.
+struct BookLevel
+{
+	BookPosition* positions = nullptr;
+	size_t count = 0;
+	size_t capacity = 0;
+};
+
+// Work shared by the threads that evaluate the book positions.
+struct BookJob
+{
+	const BookPosition* positions = nullptr;	// Positions to evaluate
+	BookEntry* entries = nullptr;				// Entry of every position, key 0 if not evaluated
+	size_t count = 0;							// Number of positions
+	std::atomic<size_t> next = 0;				// Next position to be taken by a thread
+	unsigned char depth = 0;					// Heuristic depth to evaluate to
+	HeuristicData DATA = {};					// Tables shared by every thread
+};
+
+/*
+-------------------------------------------------------------------------------------------------------
+Internal helpers
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Adds a position at the end of the level, returns false if there is no memory for it.
+
+static bool push_position(BookLevel& level, const BookPosition& position)
+{
+	if (level.count == level.capacity)
+	{
+		const size_t capacity = level.capacity ? level.capacity * 2 : 1024;
+		BookPosition* grown = (BookPosition*)realloc(level.positions, capacity * sizeof(BookPosition));
+		if (!grown)
+			return false;
+
+		level.positions = grown;
+		level.capacity = capacity;
+	}
+
+	level.positions[level.count++] = position;
+	return true;
+}
+
+// Compares positions by key, for qsort().
+
+static int compare_positions(const void* a, const void* b)
+{
+	const uint64_t ka = ((const BookPosition*)a)->key;
+	const uint64_t kb = ((const BookPosition*)b)->key;
+	return (ka > kb) - (ka < kb);
+}
+
+// Compares entries by key, for qsort().
+
+static int compare_entries(const void* a, const void* b)
+{
+	const uint64_t ka = ((const BookEntry*)a)->key;
+	const uint64_t kb = ((const BookEntry*)b)->key;
+	return (ka > kb) - (ka < kb);
+}
+
+// Sorts the level by key and removes the repeated positions, mirrored boards share their key.
+
+static void unique_positions(BookLevel& level)
+{
+	if (!level.count)
+		return;
+
+	qsort(level.positions, level.count, sizeof(BookPosition), compare_positions);
+
+	size_t n = 1;
+	for (size_t i = 1; i < level.count; i++)
+		if (level.positions[i].key != level.positions[n - 1].key)
+			level.positions[n++] = level.positions[i];
+
+	level.count = n;
+}
+
+// Fills the next level with the positions reached by one move from the given level.
+// Moves that win the game are left out, there is nothing to evaluate after them.
+
+static bool expand_level(const BookLevel& level, BookLevel& next, unsigned char ply)
+{
+	for (size_t i = 0; i < level.count; i++)
+	{
+		Board board = fromCompact(level.positions[i].board, ply & 1);
+		const uint64_t moves = legalMoves(board) & ~currentThreats(board);
+		const uint64_t state = moveState(board);
+
+		for (unsigned char column = 0; column < Board::WIDTH; column++)
+		{
+			if (!columnMove(moves, column))
+				continue;
+
+			playMove(board, column);
+			const bool pushed = push_position(next, { boardKey(board), toCompact(board) });
+			undoMove(board, column, state);
+
+			if (!pushed)
+				return false;
+		}
+	}
+
+	unique_positions(next);
+	return true;
+}
+
+// Book builder threading helper: evaluates positions of the job until there are none left.
+// Every position is deepened one step at a time, the same way the engine does, so the
+// shallow iterations order the moves of the deeper ones.
+
+static void book_worker(BookJob* job)
+{
+	for (size_t i = job->next++; i < job->count; i = job->next++)
+	{
+		const BookPosition& position = job->positions[i];
+		Board board = fromCompact(position.board, playedMoves(position.board) & 1);
+
+		for (unsigned char depth = 1; depth <= job->depth; depth++)
+			heuristicTree(board, (float)OTHER_PLAYER_WIN, (float)CURRENT_PLAYER_WIN, depth, job->DATA);
+
+		// The root entry is shared with the other threads, it might have been replaced.
+		HTTEntry root;
+		if (job->DATA.HTT->storedBoard(position.key, root) && root.flag == ENTRY_FLAG_EXACT)
+			job->entries[i] = { position.key, root.eval, root.order[0], root.heuDepth, root.bitDepth, board.moveCount };
+	}
+}
+
+/*
+-------------------------------------------------------------------------------------------------------
+Book building functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Builds an opening book with every position reached in up to the given plies, evaluated by the
+// heuristic tree up to the given depth, and writes it into the book file.
+//
+// The positions are generated one ply at a time, removing repeated ones, and are then handed
+// out one by one to the threads. The threads share the tables, since the positions of the
+// book share most of their trees. Positions whose root entry was lost are left out.
+
+size_t buildOpeningBook(const char* book_file, unsigned char plies, unsigned char depth, size_t memory_mb, unsigned n_threads)
+{
+	if (!book_file || !depth || plies >= Board::CELLS)
+		return 0;
+
+	// Every level of positions is kept, the book holds all of them.
+	BookLevel* levels = (BookLevel*)calloc((size_t)plies + 1, sizeof(BookLevel));
+	if (!levels)
+		return 0;
+
+	bool ok = push_position(levels[0], { boardKey(Board()), toCompact(Board()) });
+	size_t total = levels[0].count;
+
+	for (unsigned char ply = 0; ok && ply < plies; ply++)
+	{
+		ok = expand_level(levels[ply], levels[ply + 1], ply);
+		total += levels[ply + 1].count;
+	}
+
+	BookPosition* positions = ok ? (BookPosition*)malloc(total * sizeof(BookPosition)) : nullptr;
+	BookEntry* entries = positions ? (BookEntry*)calloc(total, sizeof(BookEntry)) : nullptr;
+
+	if (entries)
+		for (size_t ply = 0, n = 0; ply <= plies; n += levels[ply].count, ply++)
+			memcpy(positions + n, levels[ply].positions, levels[ply].count * sizeof(BookPosition));
+
+	for (size_t ply = 0; ply <= plies; ply++)
+		free(levels[ply].positions);
+	free(levels);
+
+	if (!entries)
+	{
+		free(positions);
+		return 0;
+	}
+
+	// The tables are split like the engine ones, half for each.
+	HeuristicTransTable HTT((memory_mb << 20) / 2);
+	TransTable TT((memory_mb << 20) / 2);
+
+	BookJob job;
+	job.positions = positions;
+	job.entries = entries;
+	job.count = total;
+	job.depth = depth;
+	job.DATA.HTT = &HTT;
+	job.DATA.TT = &TT;
+
+	if (!n_threads)
+		n_threads = Thread::processor_count();
+	if (!n_threads)
+		n_threads = 1;
+
+	// The calling thread works too, so the book is built even if no thread can be launched.
+	Thread* workers = new Thread[n_threads - 1];
+	for (unsigned i = 0; i < n_threads - 1; i++)
+		workers[i].start(&book_worker, &job);
+
+	book_worker(&job);
+
+	for (unsigned i = 0; i < n_threads - 1; i++)
+		workers[i].join();
+	delete[] workers;
+
+	// Positions that were not evaluated are dropped, the rest are sorted for the lookups.
+	size_t count = 0;
+	for (size_t i = 0; i < total; i++)
+		if (entries[i].key)
+			entries[count++] = entries[i];
+
+	qsort(entries, count, sizeof(BookEntry), compare_entries);
+
+	BookHeader header;
+	header.plies = plies;
+	header.depth = depth;
+	header.exactTail = job.DATA.EXACT_TAIL;
+	header.count = count;
+
+	// The book file holds the header followed by the entries sorted by key.
+	const void* parts[] = { &header, entries };
+	const size_t sizes[] = { sizeof(BookHeader), count * sizeof(BookEntry) };
+	const bool written = VirtualMemory::replace_file(book_file, parts, sizes, 2);
+
+	free(positions);
+	free(entries);
+	return written ? count : 0;
+}
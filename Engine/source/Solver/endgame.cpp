@@ -0,0 +1,327 @@
+#include "endgame.h"
+#include "bitSolver.h"
+#include "rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Header of a records file, followed by the records as they are in memory.
+struct EndgameRecordsHeader
+{
+	uint64_t magic = ENDGAME_RECORDS_MAGIC;
+	uint32_t version = ENDGAME_VERSION;
+	uint32_t kind = 0;
+	uint64_t keys = ENDGAME_KEYS;
+	uint64_t count = 0;
+};
+
+/*
+-------------------------------------------------------------------------------------------------------
+Internal helpers
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Compares records by key, for qsort().
+
+static int compare_records(const void* a, const void* b)
+{
+	const uint64_t ka = ((const EndgameRecord*)a)->key;
+	const uint64_t kb = ((const EndgameRecord*)b)->key;
+	return (ka > kb) - (ka < kb);
+}
+
+/*
+-------------------------------------------------------------------------------------------------------
+Endgame builder functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+EndgameBuilder::~EndgameBuilder()
+{
+	free(records);
+}
+
+// Adds a solved position, returns false if there is no memory for it.
+
+bool EndgameBuilder::add(uint64_t key, int8_t score)
+{
+	if (count == capacity)
+	{
+		const size_t grown_capacity = capacity ? capacity * 2 : 4096;
+		EndgameRecord* grown = (EndgameRecord*)realloc(records, grown_capacity * sizeof(EndgameRecord));
+		if (!grown)
+			return false;
+
+		records = grown;
+		capacity = grown_capacity;
+	}
+
+	// The whole record is cleared, the padding is written to the files too.
+	memset(records + count, 0, sizeof(EndgameRecord));
+	records[count].key = key;
+	records[count].score = score;
+	count++;
+	return true;
+}
+
+// Adds the positions of a records file to the ones collected.
+// Returns false if the file is not a records file of the same kind of keys.
+
+bool EndgameBuilder::load(const char* records_file)
+{
+	FILE* file = fopen(records_file, "rb");
+	if (!file)
+		return false;
+
+	EndgameRecordsHeader header;
+	bool ok = fread(&header, sizeof(EndgameRecordsHeader), 1ULL, file) == 1ULL && header.magic == ENDGAME_RECORDS_MAGIC &&
+		header.version == ENDGAME_VERSION && header.kind == keyKind && header.keys == ENDGAME_KEYS;
+
+	EndgameRecord record;
+	for (uint64_t i = 0; ok && i < header.count; i++)
+		ok = fread(&record, sizeof(EndgameRecord), 1ULL, file) == 1ULL && add(record.key, record.score);
+
+	fclose(file);
+	return ok;
+}
+
+// Writes every position collected into a records file, overwriting it.
+
+bool EndgameBuilder::save(const char* records_file) const
+{
+	EndgameRecordsHeader header;
+	header.kind = keyKind;
+	header.count = count;
+
+	const void* parts[] = { &header, records };
+	const size_t sizes[] = { sizeof(EndgameRecordsHeader), count * sizeof(EndgameRecord) };
+
+	return VirtualMemory::replace_file(records_file, parts, sizes, 2);
+}
+
+// Builds the database with every position collected and writes it into the file.
+//
+// Every level takes the keys left by the previous one. Their bits are marked in two arrays,
+// one for the bits seen and one for the bits seen twice, and the bits seen once are kept.
+// Keys that fall in a kept bit are done, the rest are moved to the front for the next level.
+// Once the levels are done the index of every key is computed with the same function the
+// probes use, and its fingerprint and score are placed there.
+
+size_t EndgameBuilder::build(const char* database_file)
+{
+	if (!count || !database_file)
+		return 0;
+
+	// Repeated positions are removed, the last score collected is the one kept.
+	qsort(records, count, sizeof(EndgameRecord), compare_records);
+
+	size_t unique = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (unique && records[unique - 1].key == records[i].key)
+			records[unique - 1] = records[i];
+		else
+			records[unique++] = records[i];
+	}
+	count = unique;
+
+	EndgameHeader header;
+	header.kind = keyKind;
+
+	// Keys still to be placed, the placed ones are only needed again to compute the indexes.
+	uint64_t* pending = (uint64_t*)malloc(count * sizeof(uint64_t));
+	uint64_t* words = nullptr;
+	uint64_t* seen = nullptr;
+	uint64_t* twice = nullptr;
+	size_t n_words = 0;
+
+	if (!pending)
+		return 0;
+
+	for (size_t i = 0; i < count; i++)
+		pending[i] = records[i].key;
+
+	size_t n_pending = count;
+	bool ok = true;
+
+	for (unsigned level = 0; ok && n_pending && level < ENDGAME_MAX_LEVELS; level++)
+	{
+		const uint64_t bits = ((uint64_t)n_pending * ENDGAME_GAMMA + ENDGAME_BLOCK_BITS - 1) / ENDGAME_BLOCK_BITS * ENDGAME_BLOCK_BITS;
+		const size_t level_words = (size_t)(bits / 64);
+
+		uint64_t* grown = (uint64_t*)realloc(words, (n_words + level_words) * sizeof(uint64_t));
+		free(seen);
+		free(twice);
+		seen = (uint64_t*)calloc(level_words, sizeof(uint64_t));
+		twice = (uint64_t*)calloc(level_words, sizeof(uint64_t));
+
+		if (!grown || !seen || !twice)
+		{
+			if (grown)
+				words = grown;
+			ok = false;
+			break;
+		}
+		words = grown;
+
+		for (size_t i = 0; i < n_pending; i++)
+		{
+			const uint64_t bit = _endgameBit(pending[i], level, bits);
+			const uint64_t mask = 1ULL << (bit & 63);
+
+			twice[bit >> 6] |= seen[bit >> 6] & mask;
+			seen[bit >> 6] |= mask;
+		}
+
+		for (size_t w = 0; w < level_words; w++)
+			words[n_words + w] = seen[w] & ~twice[w];
+
+		size_t left = 0;
+		for (size_t i = 0; i < n_pending; i++)
+		{
+			const uint64_t bit = _endgameBit(pending[i], level, bits);
+			if (!((words[n_words + (bit >> 6)] >> (bit & 63)) & 1))
+				pending[left++] = pending[i];
+		}
+
+		header.levelBits[level] = bits;
+		header.levels = level + 1;
+		n_words += level_words;
+		n_pending = left;
+	}
+
+	free(seen);
+	free(twice);
+	free(pending);
+
+	// The rank counters hold the bits set before every block, and the total at the end.
+	const size_t n_ranks = n_words / (ENDGAME_BLOCK_BITS / 64) + 1;
+	uint64_t* ranks = ok ? (uint64_t*)malloc(n_ranks * sizeof(uint64_t)) : nullptr;
+
+	if (ranks)
+	{
+		uint64_t total = 0;
+		for (size_t w = 0; w < n_words; w++)
+		{
+			if (w % (ENDGAME_BLOCK_BITS / 64) == 0)
+				ranks[w / (ENDGAME_BLOCK_BITS / 64)] = total;
+			total += std::popcount(words[w]);
+		}
+		ranks[n_ranks - 1] = total;
+
+		header.count = total;
+		header.extra = count - total;
+	}
+
+	const size_t fingerprints_bytes = (size_t)(header.count * sizeof(uint32_t) + 7) / 8 * 8;
+	const size_t scores_bytes = (size_t)(header.count + 7) / 8 * 8;
+
+	uint32_t* fingerprints = ranks ? (uint32_t*)calloc(fingerprints_bytes / sizeof(uint32_t) + 1, sizeof(uint32_t)) : nullptr;
+	int8_t* scores = fingerprints ? (int8_t*)calloc(scores_bytes + 1, sizeof(int8_t)) : nullptr;
+
+	size_t written = 0;
+
+	if (scores)
+	{
+		// Records left after the last level are moved to the front, they stay sorted by key.
+		size_t n_extra = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			uint64_t index;
+			if (_endgameIndex(header, words, ranks, records[i].key, index))
+			{
+				fingerprints[index] = _endgameFingerprint(records[i].key);
+				scores[index] = records[i].score;
+			}
+			else
+				records[n_extra++] = records[i];
+		}
+
+		const void* parts[] = { &header, words, ranks, fingerprints, scores, records };
+		const size_t sizes[] = { sizeof(EndgameHeader), n_words * sizeof(uint64_t), n_ranks * sizeof(uint64_t),
+			fingerprints_bytes, scores_bytes, n_extra * sizeof(EndgameRecord) };
+
+		if (VirtualMemory::replace_file(database_file, parts, sizes, 6))
+			written = count;
+
+		// Only the records stored apart are left, so the builder is emptied.
+		count = 0;
+	}
+
+	free(words);
+	free(ranks);
+	free(fingerprints);
+	free(scores);
+	return written;
+}
+
+/*
+-------------------------------------------------------------------------------------------------------
+Endgame building functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Plays random moves from the empty board until the given moves are played. Moves that let the
+// opponent win right away are avoided. Returns false if the game is decided before that, or the
+// player to move can win at once, those positions are solved without looking at the database.
+
+static bool random_position(Board& board, unsigned char moves, uint64_t& seed)
+{
+	board = Board();
+
+	while (board.moveCount < moves)
+	{
+		const uint64_t legal = legalMoves(board);
+		const uint64_t candidates = nonLosingMoves(board);
+		if (!candidates || (legal & currentThreats(board)))
+			return false;
+
+		unsigned char column;
+		do column = (unsigned char)(rng::splitmix(seed) % Board::WIDTH);
+		while (!columnMove(candidates, column));
+
+		playMove(board, column);
+	}
+
+	return !(legalMoves(board) & currentThreats(board));
+}
+
+// Solves the given number of random positions with the given moves played, adds them to the
+// records file and builds the database file from every position recorded.
+//
+// Positions are drawn until enough of them are solved, the ones already decided by the next
+// move are discarded. A seed of 0 is taken from the clock. A single table is used for every position, since positions with the
+// same moves played share most of their trees.
+
+size_t buildEndgameDatabase(const char* database_file, const char* records_file, size_t positions, unsigned char moves, size_t memory_mb, uint64_t seed)
+{
+	if (!database_file || !records_file || moves >= Board::CELLS)
+		return 0;
+
+	EndgameBuilder builder(endgameKind<Board>());
+
+	// Only a records file that exists and can not be loaded is an error, it would be lost.
+	if (FILE* file = fopen(records_file, "rb"))
+	{
+		fclose(file);
+		if (!builder.load(records_file))
+			return 0;
+	}
+
+	// Every run draws different positions unless a seed is given.
+	if (!seed)
+		seed = Timer::get_system_time_ns();
+
+	TransTable pathTT(memory_mb << 20);
+	Board board;
+
+	for (size_t solved = 0, tries = 0; solved < positions && tries < positions * 64; tries++)
+		if (random_position(board, moves, seed) && collectEndgame(board, builder, &pathTT))
+			solved++;
+
+	if (!builder.save(records_file))
+		return 0;
+
+	return builder.build(database_file);
+}
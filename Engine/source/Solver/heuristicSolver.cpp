@@ -8,10 +8,6 @@
 
 #define KILL_TEST 	if (DATA.STOP && *DATA.STOP)return alpha
 
-// Default move order used for low depth branches.
-
-#define DEFAULT_MOVE_ORDER { 3, 4, 2, 5, 1, 6, 0, 7 }
-
 // Moment at which the evaluate board function switches
 // to fully solving the position without heuristic.
 
@@ -57,36 +53,37 @@ static inline int _countConnect4s(const uint64_t board)
 // all the spaces in the board are occupied by that color, and it
 // subtracts the two values, the difference is the board score.
 
-static inline float heuristic(Board board, unsigned char depth, const HeuristicData& DATA)
+template<typename BoardType>
+static inline float heuristic(BoardType& board, unsigned char depth, const HeuristicData& DATA)
 {
 
 	// Generates a tree under the position to check for wins or losses
 	// This deepens the heuristic tree making the evaluation fail safe
 
-	if (SolveResult deepSolve = exactTree(board, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, depth, DATA.TT, nullptr, 0, DATA.STOP))
+	if (SolveResult deepSolve = exactTree(board, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, depth, DATA.TT, nullptr, 0, DATA.STOP, DATA.ENDGAME))
 		return (float)deepSolve;
 
 	// Here we flip the others board to represent all the possible 
 	// spots where your pieces could go later in the game
 
-	const uint64_t bitBoard0 = board.playerBitboard[board.sideToPlay];
-	const uint64_t bitBoard1 = board.playerBitboard[board.sideToPlay ^ 1u];
+	const uint64_t bitBoard0 = currentPieces(board);
+	const uint64_t bitBoard1 = otherPieces(board);
 
-	const uint64_t _bitBoard0 = ~bitBoard1;
-	const uint64_t _bitBoard1 = ~bitBoard0;
+	const uint64_t _bitBoard0 = ~bitBoard1 & BoardType::AREA;
+	const uint64_t _bitBoard1 = ~bitBoard0 & BoardType::AREA;
 
 	const uint64_t bmask = mask(board);
 	const uint64_t holes = ~bmask;
 
-	const uint64_t up1_bmask = SHIFT_NORTH(bmask) | Row0;
+	const uint64_t up1_bmask = SHIFT_NORTH(bmask) | BoardType::BOTTOM;
 	const uint64_t up1_holes = ~up1_bmask;
 
-	// This are all the 1-move wins (3 in a row) that each player has.
+	// This are all the 1-move wins (3 in a row) that each player has, read from the board threats.
 	// Those at floor level are discarded because they will either be an immediate win
 	// or immediately covered, and since deepSolve did not find a win, they are covered.
 
-	const uint64_t winningHoles0 = COLLAPSE_ALL_WINNING_MOVES(bitBoard0) & up1_holes;
-	const uint64_t winningHoles1 = COLLAPSE_ALL_WINNING_MOVES(bitBoard1) & up1_holes;
+	const uint64_t winningHoles0 = currentThreats(board) & up1_holes;
+	const uint64_t winningHoles1 = otherThreats(board) & up1_holes;
 
 	// This are holes which by their nature it is impossible for something to be built on top.
 	// Shared 1 move win, and two vertical one movers in a row.
@@ -125,19 +122,39 @@ static inline float heuristic(Board board, unsigned char depth, const HeuristicD
 	return DATA.FAVORABLES * count_Favorables + DATA.POSSIBLES * count_Possibles + DATA.FAVORABLE_1MOVE * count_Favorable_1move + DATA.POSSIBLES_1MOVE * count_Possible_1move;
 }
 
+// Translates a move order between the board and the key orientation of the tables.
+// Columns outside of the board are left untouched, returns the translated order.
+
+template<typename BoardType>
+static inline unsigned char* keyOrder(const BoardType& board, const unsigned char order[8], unsigned char translated[8])
+{
+	const bool mirrored = mirroredKey(board);
+
+	for (unsigned char i = 0; i < 8; i++)
+		translated[i] = (mirrored && order[i] < BoardType::WIDTH) ? BoardType::WIDTH - 1 - order[i] : order[i];
+
+	return translated;
+}
+
 // This function orders the moves by height from highest to lowest.
 // Also putting the invalid moves at the end.
 // This helps with pruning because most of the time the moves at 
 // the low positions are not good because they lose or they invalidate
 // a winning opportunity.
+// The heights are read from the legal moves bitmap, full columns have no move.
+// Only the first WIDTH columns of the order exist on the board.
 
-static inline void orderByHeight(const unsigned char boardHeights[8], unsigned char order[8])
+template<unsigned char WIDTH>
+static inline void orderByHeight(const uint64_t moves, unsigned char order[8])
 {
-    unsigned char heights[8];
-    for (unsigned char i = 0; i < 8; ++i)
-        heights[i] = boardHeights[order[i]];
+	unsigned char heights[8];
+	for (unsigned char i = 0; i < WIDTH; ++i)
+	{
+		const uint64_t move = columnMove(moves, order[i]);
+		heights[i] = move ? rowOf(move) : 8u;
+	}
 
-	unsigned char lastCol = 7;
+	unsigned char lastCol = WIDTH - 1;
 	unsigned char tempCol, tempHeight;
 
 	for (unsigned char i = 0; i <= lastCol; i++)
@@ -171,22 +188,52 @@ static inline void orderByHeight(const unsigned char boardHeights[8], unsigned c
 	}
 }
 
+// This function moves the columns allowed by the candidates bitmap to the front
+// of the order, keeping their relative order, and returns how many there are.
+// The rest of the moves are left at the end, where the tree will not reach them.
+
+template<unsigned char WIDTH>
+static inline unsigned char prioritizeMoves(const uint64_t candidates, unsigned char order[8])
+{
+	unsigned char prioritized[8];
+	unsigned char first = 0u, last = WIDTH;
+
+	for (unsigned char i = 0; i < WIDTH; i++)
+	{
+		if (columnMove(candidates, order[i]))
+			prioritized[first++] = order[i];
+		else
+			prioritized[--last] = order[i];
+	}
+
+	for (unsigned char i = 0; i < WIDTH; i++)
+		order[i] = prioritized[i];
+
+	return first;
+}
+
 // This function is called for trees bigger than a certain depth.
 // It generates a heuristic tree of depth 1 and orders the moves
 // according to their score, greatly improving pruning.
 
-static inline float orderMoves(Board& board, unsigned char order[8], unsigned char depth, const HeuristicData& DATA)
+template<typename BoardType>
+static inline float orderMoves(BoardType& board, unsigned char order[8], unsigned char depth, const HeuristicData& DATA)
 {
 	float scores[8] = { INVALID_BOARD, INVALID_BOARD, INVALID_BOARD, INVALID_BOARD, INVALID_BOARD, INVALID_BOARD, INVALID_BOARD, INVALID_BOARD };
 
-	for (unsigned char i = 0; i < 8; i++)
+	const uint64_t moves = legalMoves(board);
+	const uint8_t wins = winningColumns(board);
+	const uint64_t state = moveState(board);
+
+	for (unsigned char i = 0; i < BoardType::WIDTH; i++)
 	{
 		unsigned char column = order[i];
+		const uint64_t move = columnMove(moves, column);
 
-		if (!canPlay(board, column))
+		if (!move)
 			continue;
 
-		if (is_win(board.playerBitboard[board.sideToPlay] | bit_at(column, board.heights[column])))
+		if ((wins >> column) & 1)
 		{
 			order[i] = order[0];
 			order[0] = column;
@@ -195,7 +242,7 @@ static inline float orderMoves(Board& board, unsigned char order[8], unsigned ch
 
 		playMove(board, column);
 		scores[i] = -heuristic(board, depth, DATA);
-		undoMove(board, column);
+		undoMove(board, column, state);
 
 		unsigned char j = i;
 		float tempScore;
@@ -227,9 +274,14 @@ static inline float orderMoves(Board& board, unsigned char order[8], unsigned ch
 // It also uses alpha-beta pruning, this time paired with node ordering and PVS,
 // which added to the transposition tables makes the pruning a lot more efficient.
 
-inline float heuristicTree(Board& board, float alpha, float beta, unsigned char depth, const HeuristicData& DATA)
+template<typename BoardType>
+float heuristicTree(BoardType& board, float alpha, float beta, unsigned char depth, const HeuristicData& DATA)
 {
-	if (board.moveCount == 64u)
+	const uint8_t moveCount = playedMoves(board);
+	const uint64_t key = boardKey(board);
+	const uint64_t moves = legalMoves(board);
+
+	if (moveCount == BoardType::CELLS)
 		return DRAW;
 
 	KILL_TEST;
@@ -245,18 +297,16 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 	// If we know that our upper bound is lower than our alpha we return the value
 	// Else if it is smaller than our current beta we adjust beta
 
-	unsigned char order[8] = DEFAULT_MOVE_ORDER;
+	unsigned char order[8];
+	unsigned char keyed[8];
+	memcpy(order, MOVE_ORDER<BoardType::WIDTH>.center, sizeof(order));
 
-	HTTEntry* storedData = DATA.HTT[board.moveCount].storedBoard(board.hash);
+	// The table hands out a copy of the entry, so other threads can keep writing it.
 	HTTEntry aux;
+	const bool storedData = DATA.HTT->storedBoard(key, aux);
 
 	if (storedData)
 	{
-		// Do a hard copy of the entry to avoid collisions.
-		storedData->lock();
-		memcpy(&aux, storedData, sizeof(HTTEntry));
-		storedData->unlock();
-
 		// Checks the evaluation
 		float score = aux.eval;
 
@@ -286,9 +336,8 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 		if (!depth)
 			return heuristic(board, DATA.EXACT_TAIL, DATA);
 
-		// Copies move order stored
-		for (int i = 0; i < 8; ++i)
-			order[i] = aux.order[i];
+		// Copies move order stored, seen from the actual board
+		keyOrder(board, aux.order, order);
 	}
 	
 	// If is does not have stored data of the position it means it is a first encounter
@@ -308,7 +357,7 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 			KILL_TEST;
 
 			if (surfaceCheck == 1.f || surfaceCheck == -1.f)
-				return DATA.HTT[board.moveCount].store(board.hash, order, surfaceCheck, depth, DATA.EXACT_TAIL, ENTRY_FLAG_EXACT);
+				return DATA.HTT->store(key, keyOrder(board, order, keyed), surfaceCheck, depth, DATA.EXACT_TAIL, ENTRY_FLAG_EXACT, moveCount);
 		}
 
 		// Otherwise it orders the nodes by height, it performs a simple 
@@ -319,7 +368,7 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 			// It orders the moves from highest column to lowest column.
 			// Leaving invalid moves at the end.
 
-			orderByHeight(board.heights, order);
+			orderByHeight<BoardType::WIDTH>(moves, order);
 
 			// Tree cutoff, returns heuristic.
 
@@ -327,28 +376,31 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 			{
 				float eval = heuristic(board, DATA.EXACT_TAIL, DATA);
 				KILL_TEST;
-				return DATA.HTT[board.moveCount].store(board.hash, order, eval, depth, DATA.EXACT_TAIL, ENTRY_FLAG_EXACT);;
+				return DATA.HTT->store(key, keyOrder(board, order, keyed), eval, depth, DATA.EXACT_TAIL, ENTRY_FLAG_EXACT, moveCount);
 			}
 
 			// Checks if a move is winning for the current player.
 			// Wins are checked here so there is no need to check them anywhere else.
 
-			for (unsigned char i = 0; i < 8; i++)
+			const uint8_t wins = winningColumns(board);
+
+			for (unsigned char i = 0; i < BoardType::WIDTH; i++)
 			{
 				unsigned char column = order[i];
+				const uint64_t move = columnMove(moves, column);
 
 				// If a move is invalid it has reached the end due to ordering.
 
-				if (!canPlay(board, column))
+				if (!move)
 					break;
 
 				// Checks if positioning a piece in this column results in an instant win, returns if thats the case
 
-				if (is_win(board.playerBitboard[board.sideToPlay] | bit_at(column, board.heights[column])))
+				if ((wins >> column) & 1)
 				{
 					order[i] = order[0];
 					order[0] = column;
-					return DATA.HTT[board.moveCount].store(board.hash, order, YOU_WIN, depth, DATA.EXACT_TAIL, ENTRY_FLAG_EXACT);
+					return DATA.HTT->store(key, keyOrder(board, order, keyed), YOU_WIN, depth, DATA.EXACT_TAIL, ENTRY_FLAG_EXACT, moveCount);
 				}
 
 			}
@@ -356,6 +408,22 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 
 	}
 
+	// Moves that give the opponent an immediate win are sent to the end of the order
+	// and are not searched. If every move does so the position is lost.
+
+	const uint64_t candidates = nonLosingMoves(board);
+
+	if (!candidates)
+		return DATA.HTT->store(key, keyOrder(board, order, keyed), OTHER_WIN, depth, DATA.EXACT_TAIL, ENTRY_FLAG_EXACT, moveCount);
+
+	const unsigned char n_candidates = prioritizeMoves<BoardType::WIDTH>(candidates, order);
+
+#ifdef _TT_PREFETCH
+	// The entries of every child are requested before searching the first one, see tt.h.
+	for (unsigned char i = 0; i < n_candidates; i++)
+		DATA.HTT->prefetch(childKey(board, order[i]));
+#endif
+
 	// Once the TT has been checked, the moves are ordered and no wins or losses 
 	// have been found, the alpha beta pruning tree algorithm is used.
 	// 
@@ -365,33 +433,31 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 	// actually do anything good and if they can it allows them to search the full scope.
 
 	float alpha0 = alpha;
+	const uint64_t state = moveState(board);
 	playMove(board, order[0]);
 	float score = -heuristicTree(board, -beta, -alpha, depth - 1, DATA);  // full window
 	KILL_TEST;
-	undoMove(board, order[0]);
+	undoMove(board, order[0], state);
 
 	float best = score;
 	if (best > alpha)
 	{
 		alpha = best;
 		if (alpha >= beta)
-			return DATA.HTT[board.moveCount].store(board.hash, order, best, depth, DATA.EXACT_TAIL, (alpha == YOU_WIN) ? ENTRY_FLAG_EXACT : ENTRY_FLAG_LOWER);
+			return DATA.HTT->store(key, keyOrder(board, order, keyed), best, depth, DATA.EXACT_TAIL, (alpha == YOU_WIN) ? ENTRY_FLAG_EXACT : ENTRY_FLAG_LOWER, moveCount);
 	}
 
-	for (unsigned char i = 1; i < 8; i++)
+	for (unsigned char i = 1; i < n_candidates; i++)
 	{
 		unsigned char column = order[i];
 
-		if (!canPlay(board, column))
-			break;
-
 		playMove(board, column);
 		float score = -heuristicTree(board, -alpha - POINT_DISTANCE, -alpha, depth - 1, DATA); // probe
 		KILL_TEST;
 		if (score > alpha)
 			score = -heuristicTree(board, -beta, -alpha, depth - 1, DATA);  // re-search at full window
 		KILL_TEST;
-		undoMove(board, column);
+		undoMove(board, column, state);
 
 		if (score > best)
 		{
@@ -405,14 +471,14 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 			{
 				alpha = best;
 				if (alpha >= beta)
-					return DATA.HTT[board.moveCount].store(board.hash, order, best, depth, DATA.EXACT_TAIL, (alpha == YOU_WIN) ? ENTRY_FLAG_EXACT : ENTRY_FLAG_LOWER);
+					return DATA.HTT->store(key, keyOrder(board, order, keyed), best, depth, DATA.EXACT_TAIL, (alpha == YOU_WIN) ? ENTRY_FLAG_EXACT : ENTRY_FLAG_LOWER, moveCount);
 			}
 		}
 	}
 
 	// Before returning it always saves the position in the TT
 
-	return DATA.HTT[board.moveCount].store(board.hash, order, best, depth, DATA.EXACT_TAIL, (best <= alpha0 && best != OTHER_WIN) ? ENTRY_FLAG_UPPER : ENTRY_FLAG_EXACT);
+	return DATA.HTT->store(key, keyOrder(board, order, keyed), best, depth, DATA.EXACT_TAIL, (best <= alpha0 && best != OTHER_WIN) ? ENTRY_FLAG_UPPER : ENTRY_FLAG_EXACT, moveCount);
 }
 
 // Evaluates the given board position up to a certain depth.
@@ -420,10 +486,9 @@ inline float heuristicTree(Board& board, float alpha, float beta, unsigned char
 // If it finds a winning move it reanalises the position to find the fastest path.
 // If if finds a losing move it reanalises the position to find the longest path.
 
-SolveEval evaluateBoard(const Board& initialBoard, unsigned char depth, HeuristicData const* DATA)
+template<typename BoardType>
+SolveEval evaluateBoard(const BoardType& initialBoard, unsigned char depth, HeuristicData const* DATA)
 {
-	init_zobrist();
-
 	HeuristicData USING_DATA = {};
 	if (DATA)
 		USING_DATA = *DATA;
@@ -431,42 +496,39 @@ SolveEval evaluateBoard(const Board& initialBoard, unsigned char depth, Heuristi
 	if (invalidBoard(initialBoard))
 		return SolveEval(0.f, 0, 0, INVALID_BOARD);
 
-	if (is_win(initialBoard.playerBitboard[initialBoard.sideToPlay]))
+	if (is_win(currentPieces(initialBoard)))
 		return SolveEval(1.f, 8,0, CURRENT_PLAYER_WIN);
 
-	if (is_win(initialBoard.playerBitboard[initialBoard.sideToPlay ^ 1]))
+	if (is_win(otherPieces(initialBoard)))
 		return SolveEval(-1.f, 8,0, OTHER_PLAYER_WIN);
 
-	Board board = initialBoard;
+	BoardType board = initialBoard;
+	const uint8_t moveCount = playedMoves(board);
 	
 	// If the depth demanded is higher than the remaining move count
 	// or the remaining move count is below a certain threshold
 	// it will compute the entirity of the remaining board
 
-	if (depth + USING_DATA.EXACT_TAIL > 64 - board.moveCount || board.moveCount >= MOVE_COUNT_TRIGGER)
+	if (depth + USING_DATA.EXACT_TAIL > BoardType::CELLS - moveCount || moveCount >= MOVE_COUNT_TRIGGER)
 	{
-		float eval = (float)solveBoard(board, 64 - board.moveCount, USING_DATA.TT);
-		unsigned char column = retrieveColumn(board, USING_DATA.TT);
+		if (moveCount == BoardType::CELLS)
+			return SolveEval((float)DRAW, 255, 255, DRAW);
 
-		if (eval == YOU_WIN)
-		{
-			char* quickest = findBestPath(board, CURRENT_PLAYER_WIN);
-			column = quickest[0];
-			depth = quickest[1];
-			free(quickest);
-			return SolveEval(YOU_WIN, column, depth, CURRENT_PLAYER_WIN);
-		}
+		// A single distance search gives the result, the best column and the distance together.
+		// Its scores are distances, so it uses its own table and never the one of the exact solver.
+		char* solution = findBestPath(board, DRAW);
+		const unsigned char column = solution[0];
+		const unsigned char distance = solution[1];
+		const SolveResult result = (SolveResult)solution[2];
+		free(solution);
 
-		else if (eval == OTHER_WIN)
-		{
-			char* quickest = findBestPath(board, OTHER_PLAYER_WIN);
-			column = quickest[0];
-			depth = quickest[1];
-			free(quickest);
-			return SolveEval(OTHER_WIN, column, depth, OTHER_PLAYER_WIN);
-		}
+		if (result == CURRENT_PLAYER_WIN)
+			return SolveEval(YOU_WIN, column, distance, CURRENT_PLAYER_WIN);
 
-		return SolveEval(eval, column, 255, DRAW);
+		else if (result == OTHER_PLAYER_WIN)
+			return SolveEval(OTHER_WIN, column, distance, OTHER_PLAYER_WIN);
+
+		return SolveEval((float)DRAW, column, 255, DRAW);
 	}
 
 	// Here it initialises transposition tables if necessary and calls the tree creation
@@ -474,17 +536,14 @@ SolveEval evaluateBoard(const Board& initialBoard, unsigned char depth, Heuristi
 
 	if (!USING_DATA.HTT)
 	{
-		static HeuristicTransTable* HTT = (HeuristicTransTable*)calloc(64 + 1, sizeof(HeuristicTransTable));
+		static HeuristicTransTable* HTT = new HeuristicTransTable();
 		USING_DATA.HTT = HTT;
 	}
 
-	for (int d = board.moveCount; d < board.moveCount + depth + 1; d++)
-		if (!USING_DATA.HTT[d].is_init())
-			USING_DATA.HTT[d].init();
-
 	float eval = heuristicTree(board, OTHER_PLAYER_WIN, CURRENT_PLAYER_WIN, depth, USING_DATA);
 
-	unsigned char column = USING_DATA.HTT[board.moveCount].storedBoard(board.hash)->order[0];
+	HTTEntry root;
+	unsigned char column = USING_DATA.HTT->storedBoard(boardKey(board), root) ? keyColumn(board, root.order[0]) : MOVE_ORDER<BoardType::WIDTH>.center[0];
 
 	// Depending on the obtained evaluationg will return the value with a different flag
 	// also if it is a Mate situation will find the best path for either player.
@@ -512,3 +571,13 @@ SolveEval evaluateBoard(const Board& initialBoard, unsigned char depth, Heuristi
 	else
 		return SolveEval(eval, column, depth, DRAW);
 }
+
+// Explicit instantiations of the solver for every supported board representation.
+
+#define INSTANTIATE_HEURISTIC_SOLVER(BoardType) \
+	template float heuristicTree<BoardType>(BoardType&, float, float, unsigned char, const HeuristicData&); \
+	template SolveEval evaluateBoard<BoardType>(const BoardType&, unsigned char, HeuristicData const*);
+
+INSTANTIATE_HEURISTIC_SOLVER(Board)
+INSTANTIATE_HEURISTIC_SOLVER(Board7x6)
+INSTANTIATE_HEURISTIC_SOLVER(CompactBoard7x6)
\ No newline at end of file
@@ -3,6 +3,7 @@
 #ifdef _TRAINING
 #include "heuristicSolver.h"
 #include "Engine.h"
+#include "tablepool.h"
 #include "Thread.h"
 #include "rng.h"
 
@@ -207,9 +208,9 @@ static inline float compute_elo_diff(float player1_elo, float player2_elo, char
 
 // Helper function to thread games in tournament.
 
-static inline void threaded_match(float sec_per_move, bool see_time_left, Board board, NeuralNetwork* nn_1, NeuralNetwork* nn_2, unsigned char* result)
+static inline void threaded_match(float sec_per_move, bool see_time_left, Board board, NeuralNetwork* nn_1, NeuralNetwork* nn_2, unsigned char* result, TablePool* pool, unsigned owner_1, unsigned owner_2)
 {
-	unsigned char winner = Trainer::NNvsNN(sec_per_move, see_time_left, board, nn_1, nn_2, false, false);
+	unsigned char winner = Trainer::NNvsNN(sec_per_move, see_time_left, board, nn_1, nn_2, false, false, pool, owner_1, owner_2);
 	*result = winner;
 }
 
@@ -226,6 +227,10 @@ void Trainer::elo_games_tournament(NeuralNetwork** NNs, float* scores, unsigned
 
 		Thread arena[2] = { Thread(), Thread() };
 
+		// Games are played one at a time, so the pool holds the memory of the two engines of a game.
+		// Every player keeps its entries apart, and finds them again in its next games.
+		TablePool pool(2 * ENGINE_DEFAULT_MEMORY_MB);
+
 	for (unsigned round = 0; round < match_rounds; round++)
 	{
 		printf("\nROUND %u/%u\n", round + 1, match_rounds);
@@ -261,13 +266,13 @@ void Trainer::elo_games_tournament(NeuralNetwork** NNs, float* scores, unsigned
 				unsigned char game_result1;
 				unsigned char game_result2;
 
-				if (arena[0].start(&threaded_match, time_per_move, see_time_left, initial_board, player1, player2, &game_result1))
+				if (arena[0].start(&threaded_match, time_per_move, see_time_left, initial_board, player1, player2, &game_result1, &pool, p1 + 1, p2 + 1))
 				{
 					arena[0].set_priority(Thread::PRIORITY_ABOVE_NORMAL);
 					arena[0].set_name(L"Game %u.1: Player #%02u vs Player #%02u", game + 1, p1, p2);
 				} else throw("ERROR: Unable to start game thread");
 				arena[0].join();
-				if (arena[1].start(&threaded_match, time_per_move, see_time_left, initial_board, player2, player1, &game_result2))
+				if (arena[1].start(&threaded_match, time_per_move, see_time_left, initial_board, player2, player1, &game_result2, &pool, p2 + 1, p1 + 1))
 				{
 					arena[1].set_priority(Thread::PRIORITY_ABOVE_NORMAL);
 					arena[1].set_name(L"Game %02u.2: Player #%u vs Player #%02u", game + 1, p2, p1);
@@ -302,10 +307,18 @@ void Trainer::elo_games_tournament(NeuralNetwork** NNs, float* scores, unsigned
 // Game between two different engines using the specified schedulers, given a certain time per move 
 // and an initial board. It returns 0 if it is a draw, 1 if nn_1 wins and 2 if nn_2 wins.
 
-inline unsigned char Trainer::NNvsNN(float sec_per_move, bool see_time_left, Board board, NeuralNetwork* nn_1, NeuralNetwork* nn_2, bool print_boards, bool clear_console)
+inline unsigned char Trainer::NNvsNN(float sec_per_move, bool see_time_left, Board board, NeuralNetwork* nn_1, NeuralNetwork* nn_2, bool print_boards, bool clear_console, TablePool* pool, unsigned owner_1, unsigned owner_2)
 {
-	EngineConnect4 player1(&board, nn_1);
-	EngineConnect4 player2(&board, nn_2);
+	const size_t memory_mb = pool ? 0 : ENGINE_DEFAULT_MEMORY_MB;
+
+	EngineConnect4 player1(&board, nn_1, false, memory_mb);
+	EngineConnect4 player2(&board, nn_2, false, memory_mb);
+
+	if (pool)
+	{
+		player1.attach_tables(pool, owner_1);
+		player2.attach_tables(pool, owner_2);
+	}
 
 	while (board.moveCount < 64)
 	{
@@ -404,6 +417,10 @@ void Trainer::deeper_search_tournament(NeuralNetwork** NNs, float* scores, unsig
 {
 	Thread player_threads[BATCH_SIZE];
 
+	// Only a batch of engines searches at once, so the pool holds the memory of a batch.
+	// Every engine keeps its entries apart, its score depends on the depths it reaches.
+	TablePool pool(BATCH_SIZE * ENGINE_DEFAULT_MEMORY_MB);
+
 	for (unsigned game = 0; game < games; game++)
 	{
 		Board board = {};
@@ -411,14 +428,21 @@ void Trainer::deeper_search_tournament(NeuralNetwork** NNs, float* scores, unsig
 		for (unsigned move = 0; move < n_random_moves; move++)
 			playMove(board, rng::random_unsigned(0, 7));
 
+		// The entries of the previous game are dropped, every game starts from empty tables.
+		pool.clear();
+
 		EngineConnect4** players = (EngineConnect4**)calloc(n_players + BATCH_SIZE, sizeof(EngineConnect4*));
 		for (unsigned i = 0; i < n_players; i++)
-			players[i] = new EngineConnect4(nullptr, NNs[i], true);
+		{
+			players[i] = new EngineConnect4(nullptr, NNs[i], true, 0);
+			players[i]->attach_tables(&pool, i + 1);
+		}
 
 		EngineConnect4** schedulers = players + n_players;
 		for (unsigned i = 0; i < BATCH_SIZE; i++)
 		{
-			schedulers[i] = new EngineConnect4(nullptr, (NeuralNetwork*)nullptr, true);
+			schedulers[i] = new EngineConnect4(nullptr, (NeuralNetwork*)nullptr, true, 0);
+			schedulers[i]->attach_tables(&pool, n_players + i + 1);
 			((HeuristicData*)schedulers[i]->threadedData)->EXACT_TAIL = 10u - i;
 		}
 
@@ -452,18 +476,19 @@ void Trainer::deeper_search_tournament(NeuralNetwork** NNs, float* scores, unsig
 				for (unsigned i = 0; i < BATCH_SIZE; i++)
 				{
 					player_threads[i].join();
-					HTTEntry* entry = schedulers[i]->get_entry(&board);
-					TTEntry* exact_entry = schedulers[i]->get_exact_entry(&board);
+					HTTEntry entry;
+					const bool stored = schedulers[i]->get_entry(&board, entry);
+					TTEntry exact_entry;
 					uint8_t exact_depth = 0;
-					if (exact_entry)
-						exact_depth = exact_entry->depth;
+					if (schedulers[i]->get_exact_entry(&board, exact_entry))
+						exact_depth = exact_entry.depth;
 
-					if (!entry || entry->flag != ENTRY_FLAG_EXACT)
+					if (!stored || entry.flag != ENTRY_FLAG_EXACT)
 						printf("Scheduler #%u did not manage to get a single tree done.\n", i);
-					else if (entry->eval == 1.f || entry->eval == -1.f)
+					else if (entry.eval == 1.f || entry.eval == -1.f)
 						printf("Scheduler #%u solved the board.\n", i);
 					else
-						printf("Scheduler #%u evaluated to depths (%hhu, %hhu, %hhu)\n", i, entry->heuDepth, entry->bitDepth, exact_depth);
+						printf("Scheduler #%u evaluated to depths (%hhu, %hhu, %hhu)\n", i, entry.heuDepth, entry.bitDepth, exact_depth);
 				}
 				global_eval = schedulers[0]->get_evaluation(&board);
 				printf("\n");
@@ -483,26 +508,27 @@ void Trainer::deeper_search_tournament(NeuralNetwork** NNs, float* scores, unsig
 					for (unsigned i = 0; i < BATCH_SIZE && i + n < n_players; i++)
 					{
 						player_threads[i].join();
-						HTTEntry* entry = players[n + i]->get_entry(&board);
-						TTEntry* exact_entry = players[n + i]->get_exact_entry(&board);
+						HTTEntry entry;
+						const bool stored = players[n + i]->get_entry(&board, entry);
+						TTEntry exact_entry;
 						uint8_t exact_depth = 0;
-						if (exact_entry)
-							exact_depth = exact_entry->depth;
+						if (players[n + i]->get_exact_entry(&board, exact_entry))
+							exact_depth = exact_entry.depth;
 
-						if (!entry || entry->flag != ENTRY_FLAG_EXACT)
+						if (!stored || entry.flag != ENTRY_FLAG_EXACT)
 						{
 							printf("Player #%02u did not manage to get a single tree done. Score %.2f\n", n + i, ARBITRARY_NO_ENTRY_SCORE);
 							scores[n + i] += ARBITRARY_NO_ENTRY_SCORE / ARBITRARY_SCORE_DIVIDER;
 						}
-						else if (entry->eval == 1.f || entry->eval == -1.f || entry->bitDepth + entry->heuDepth + board.moveCount == 64)
+						else if (entry.eval == 1.f || entry.eval == -1.f || entry.bitDepth + entry.heuDepth + board.moveCount == 64)
 						{
 							printf("Player #%02u solved the board. Score +%.2f\n", n + i, ARBITRARY_SOLVED_BOARD_SCORE);
 							scores[n + i] += ARBITRARY_SOLVED_BOARD_SCORE / ARBITRARY_SCORE_DIVIDER;
 						}
 						else
 						{
-							float score = (1.f + sqrtf(entry->heuDepth * 1.2f)) * (1.f + sqrtf(entry->bitDepth)) * (1.f + sqrtf(exact_depth));
-							printf("Player #%02u evaluated to depths (%hhu, %hhu, %hhu). Score +%.2f\n", n + i, entry->heuDepth, entry->bitDepth, exact_depth, score);
+							float score = (1.f + sqrtf(entry.heuDepth * 1.2f)) * (1.f + sqrtf(entry.bitDepth)) * (1.f + sqrtf(exact_depth));
+							printf("Player #%02u evaluated to depths (%hhu, %hhu, %hhu). Score +%.2f\n", n + i, entry.heuDepth, entry.bitDepth, exact_depth, score);
 							scores[n + i] += score / ARBITRARY_SCORE_DIVIDER;
 						}
 					}
@@ -5,12 +5,84 @@
 #include "Engine_NN.h"
 #include "bitSolver.h"
 
+#include "book.h"
+#include "endgame.h"
+
 #include "rng.h"
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Prints how to call the offline tools of the engine.
+static int usage(const char* program)
+{
+	printf("Usage:\n");
+	printf("  %s --book <book file> <plies> <depth> [memory MB] [threads]\n", program);
+	printf("    Builds an opening book with every position up to the given plies, evaluated to the given depth.\n");
+	printf("  %s --endgame <database file> <records file> <positions> [moves] [memory MB]\n", program);
+	printf("    Solves random positions with the given moves played and adds them to the endgame database.\n");
+	return 1;
+}
 
-int main()
+int main(int argc, char** argv)
 {
+	// OPENING BOOK BUILDER
+
+	if (argc > 1 && !strcmp(argv[1], "--book"))
+	{
+		if (argc < 5)
+			return usage(argv[0]);
+
+		const unsigned long plies = strtoul(argv[3], nullptr, 10);
+		const unsigned long depth = strtoul(argv[4], nullptr, 10);
+		const size_t memory_mb = argc > 5 ? (size_t)strtoull(argv[5], nullptr, 10) : BOOK_DEFAULT_MEMORY_MB;
+		const unsigned n_threads = argc > 6 ? (unsigned)strtoul(argv[6], nullptr, 10) : 0u;
+
+		if (plies >= Board::CELLS || !depth || depth > Board::CELLS || !memory_mb)
+			return usage(argv[0]);
+
+		Timer timer;
+		const size_t written = buildOpeningBook(argv[2], (unsigned char)plies, (unsigned char)depth, memory_mb, n_threads);
+		if (!written)
+		{
+			printf("The book %s could not be built.\n", argv[2]);
+			return 1;
+		}
+
+		printf("Book %s built with %zu positions in %.2fs.\n", argv[2], written, timer.check());
+		return 0;
+	}
+
+	// ENDGAME DATABASE BUILDER
+
+	if (argc > 1 && !strcmp(argv[1], "--endgame"))
+	{
+		if (argc < 5)
+			return usage(argv[0]);
+
+		const size_t positions = (size_t)strtoull(argv[4], nullptr, 10);
+		const unsigned long moves = argc > 5 ? strtoul(argv[5], nullptr, 10) : ENDGAME_DEFAULT_MOVES;
+		const size_t memory_mb = argc > 6 ? (size_t)strtoull(argv[6], nullptr, 10) : ENDGAME_DEFAULT_MEMORY_MB;
+
+		if (!positions || moves >= Board::CELLS || !memory_mb)
+			return usage(argv[0]);
+
+		Timer timer;
+		const size_t written = buildEndgameDatabase(argv[2], argv[3], positions, (unsigned char)moves, memory_mb);
+		if (!written)
+		{
+			printf("The endgame database %s could not be built.\n", argv[2]);
+			return 1;
+		}
+
+		printf("Endgame database %s built with %zu positions in %.2fs.\n", argv[2], written, timer.check());
+		return 0;
+	}
+
+	if (argc > 1)
+		return usage(argv[0]);
+
 	// ENGINE LIVE MATCH
 
 	//engineAgainstEngine(5.0f, Connect4());
@@ -376,6 +376,15 @@ int Thread::waitForThreads(const Thread* const* threads, unsigned int n_threads,
     return -1;
 }
 
+// Returns the number of logical processors of the system.
+
+unsigned Thread::processor_count()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (unsigned)info.dwNumberOfProcessors;
+}
+
 // Static array declaration, used for thread wake-up calls.
 
 short Thread::wakeUpGen[256] = { 0 };
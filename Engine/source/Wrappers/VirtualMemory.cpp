@@ -0,0 +1,381 @@
+#include "VirtualMemory.h"
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include "Thread.h"
+#include <windows.h>
+#pragma comment(lib, "advapi32.lib") // For the lock memory privilege needed by large pages
+#else
+#include <thread>	// The Thread wrapper is only implemented for Windows
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+-------------------------------------------------------------------------------------------------------
+Internal helpers
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Rounds the bytes up to a multiple of the page size.
+
+static inline size_t round_to_pages(size_t bytes, size_t page_size)
+{
+    return (bytes + page_size - 1) / page_size * page_size;
+}
+
+// Sets to zero a chunk of memory, used as the worker of clear().
+
+static void clear_chunk(unsigned char* memory, size_t bytes)
+{
+    memset(memory, 0, bytes);
+}
+
+#ifdef _WIN32
+// Large pages need the SeLockMemoryPrivilege to be enabled in the process token.
+// The user needs to hold it ("Lock pages in memory" policy), otherwise it fails.
+
+static bool enable_lock_memory_privilege()
+{
+    static int enabled = -1;
+    if (enabled != -1)
+        return enabled;
+
+    HANDLE token;
+    enabled = 0;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return false;
+
+    TOKEN_PRIVILEGES tp = {};
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    if (LookupPrivilegeValueW(NULL, L"SeLockMemoryPrivilege", &tp.Privileges[0].Luid) &&
+        AdjustTokenPrivileges(token, FALSE, &tp, 0, NULL, NULL) &&
+        GetLastError() == ERROR_SUCCESS)
+        enabled = 1;
+
+    CloseHandle(token);
+    return enabled;
+}
+#elif defined MADV_HUGEPAGE
+// Checks whether transparent huge pages can be requested with madvise().
+
+static bool transparent_huge_pages()
+{
+    static int enabled = -1;
+    if (enabled != -1)
+        return enabled;
+
+    enabled = 0;
+    FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (!f)
+        return false;
+
+    char mode[64] = {};
+    if (fgets(mode, sizeof(mode), f))
+        enabled = strstr(mode, "[always]") || strstr(mode, "[madvise]");
+
+    fclose(f);
+    return enabled;
+}
+#endif
+
+/*
+-------------------------------------------------------------------------------------------------------
+User end VirtualMemory class functions
+-------------------------------------------------------------------------------------------------------
+*/
+
+// Returns the large page size supported by the system, 0 if not supported.
+
+size_t VirtualMemory::large_page_size()
+{
+#ifdef _WIN32
+    return (size_t)GetLargePageMinimum();
+#elif defined __linux__
+    static size_t huge_size = 0;
+    if (huge_size)
+        return huge_size;
+
+    // Default huge page size as reported by the kernel, 2MB on x86-64.
+    huge_size = 2ULL << 20;
+    if (FILE* f = fopen("/proc/meminfo", "r"))
+    {
+        char line[128];
+        size_t kb;
+        while (fgets(line, sizeof(line), f))
+            if (sscanf(line, "Hugepagesize: %zu kB", &kb) == 1)
+            {
+                huge_size = kb << 10;
+                break;
+            }
+        fclose(f);
+    }
+    return huge_size;
+#else
+    return 0;
+#endif
+}
+
+// Returns the normal page size of the system.
+
+size_t VirtualMemory::system_page_size()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (size_t)info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// Allocates at least the given bytes of zeroed memory aligned to its page size.
+// It tries large pages first, the size of the pages obtained is stored in page_size.
+
+void* VirtualMemory::allocate(size_t bytes, size_t& page_size)
+{
+    if (!bytes)
+        return nullptr;
+
+    const size_t large = large_page_size();
+
+#ifdef _WIN32
+    // Large pages are committed and locked right away, so only worth it for big blocks.
+    if (large && bytes >= large && enable_lock_memory_privilege())
+    {
+        void* memory = VirtualAlloc(NULL, round_to_pages(bytes, large), MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (memory)
+        {
+            page_size = large;
+            return memory;
+        }
+    }
+
+    page_size = system_page_size();
+    return VirtualAlloc(NULL, round_to_pages(bytes, page_size), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#ifdef MAP_HUGETLB
+    // Reserved huge pages (vm.nr_hugepages), fails if there are not enough of them.
+    if (large && bytes >= large)
+    {
+        void* memory = mmap(NULL, round_to_pages(bytes, large), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            page_size = large;
+            return memory;
+        }
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    // Transparent huge pages, the block is aligned to the huge page size so the kernel can back it.
+    if (large && bytes >= large && transparent_huge_pages())
+    {
+        const size_t length = round_to_pages(bytes, large);
+        unsigned char* mapped = (unsigned char*)mmap(NULL, length + large, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped != (unsigned char*)MAP_FAILED)
+        {
+            unsigned char* memory = (unsigned char*)round_to_pages((size_t)mapped, large);
+
+            // The unaligned head and the tail left over are given back.
+            if (memory != mapped)
+                munmap(mapped, memory - mapped);
+            if (memory + length != mapped + length + large)
+                munmap(memory + length, mapped + large - memory);
+
+            madvise(memory, length, MADV_HUGEPAGE);
+            page_size = large;
+            return memory;
+        }
+    }
+#endif
+
+    page_size = system_page_size();
+    void* memory = mmap(NULL, round_to_pages(bytes, page_size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory != MAP_FAILED ? memory : nullptr;
+#endif
+}
+
+// Releases the memory returned by allocate() with the same bytes and page size.
+
+void VirtualMemory::release(void* memory, size_t bytes, size_t page_size)
+{
+    if (!memory)
+        return;
+
+#ifdef _WIN32
+    (void)bytes; (void)page_size;
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, round_to_pages(bytes, page_size));
+#endif
+}
+
+// Maps a whole file into memory and stores its size in bytes. The file is only opened for 
+// reading, copy-on-write pages are private to the process and never written back.
+
+void* VirtualMemory::map_file(const char* filename, size_t& bytes, bool copy_on_write)
+{
+    if (!filename)
+        return nullptr;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || !file_size.QuadPart)
+    {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return nullptr;
+
+    // The view keeps the mapping alive, so its handle can be closed right away.
+    void* memory = MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!memory)
+        return nullptr;
+
+    bytes = (size_t)file_size.QuadPart;
+    return memory;
+#else
+    const int file = open(filename, O_RDONLY);
+    if (file < 0)
+        return nullptr;
+
+    struct stat info;
+    if (fstat(file, &info) || !info.st_size)
+    {
+        close(file);
+        return nullptr;
+    }
+
+    // The mapping keeps the file alive, so it can be closed right away.
+    void* memory = mmap(NULL, (size_t)info.st_size, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (memory == MAP_FAILED)
+        return nullptr;
+
+    bytes = (size_t)info.st_size;
+    return memory;
+#endif
+}
+
+// Unmaps the memory returned by map_file() with the same bytes.
+
+void VirtualMemory::unmap_file(void* memory, size_t bytes)
+{
+    if (!memory)
+        return;
+
+#ifdef _WIN32
+    (void)bytes;
+    UnmapViewOfFile(memory);
+#else
+    munmap(memory, bytes);
+#endif
+}
+
+// Writes the given parts one after the other into the file, replacing it.
+// The file is written under a temporary name and then renamed.
+
+bool VirtualMemory::replace_file(const char* filename, const void* const* parts, const size_t* sizes, size_t n_parts)
+{
+    char temp[FILENAME_MAX];
+    if (!filename || snprintf(temp, sizeof(temp), "%s.tmp", filename) >= (int)sizeof(temp))
+        return false;
+
+    FILE* file = fopen(temp, "wb");
+    if (!file)
+        return false;
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < n_parts; i++)
+        ok = !sizes[i] || fwrite(parts[i], 1ULL, sizes[i], file) == sizes[i];
+
+    ok = (fclose(file) == 0) && ok;
+
+    // Rename does not replace existing files in every system.
+    if (ok)
+    {
+        remove(filename);
+        ok = rename(temp, filename) == 0;
+    }
+    if (!ok)
+        remove(temp);
+
+    return ok;
+}
+
+// Sets to zero the given bytes of memory, splitting the work across threads.
+// Each thread clears whole pages, so it is also the first to touch them.
+
+void VirtualMemory::clear(void* memory, size_t bytes, size_t page_size)
+{
+    if (!memory || !bytes)
+        return;
+
+#ifdef _WIN32
+    const unsigned processors = Thread::processor_count();
+#else
+    const unsigned processors = std::thread::hardware_concurrency();
+#endif
+
+    size_t n_threads = bytes / VM_CLEAR_MIN_CHUNK;
+    if (n_threads > processors)
+        n_threads = processors;
+    if (n_threads > VM_CLEAR_MAX_THREADS)
+        n_threads = VM_CLEAR_MAX_THREADS;
+
+    // Small blocks are cleared faster than a thread can be created.
+    if (n_threads < 2)
+    {
+        clear_chunk((unsigned char*)memory, bytes);
+        return;
+    }
+
+    const size_t chunk = round_to_pages(bytes / n_threads, page_size);
+
+#ifdef _WIN32
+    Thread workers[VM_CLEAR_MAX_THREADS];
+#else
+    std::thread workers[VM_CLEAR_MAX_THREADS];
+#endif
+    unsigned launched = 0;
+
+    // The calling thread takes the last chunk while the others run.
+    size_t offset = 0;
+    while (offset + chunk < bytes && launched < n_threads - 1)
+    {
+#ifdef _WIN32
+        if (!workers[launched].start(&clear_chunk, (unsigned char*)memory + offset, chunk))
+            break;
+#else
+        try
+        {
+            workers[launched] = std::thread(&clear_chunk, (unsigned char*)memory + offset, chunk);
+        }
+        catch (...)
+        {
+            break;
+        }
+#endif
+
+        launched++;
+        offset += chunk;
+    }
+    clear_chunk((unsigned char*)memory + offset, bytes - offset);
+
+    for (unsigned i = 0; i < launched; i++)
+        workers[i].join();
+}